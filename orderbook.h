@@ -0,0 +1,3317 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <list>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <iomanip> // For std::setw, std::left
+#include <atomic>
+#include <thread>
+#include <type_traits>
+
+#include "orderbook_instrumentation.h"
+#include "orderbook_simd.h"
+
+// --- Enums and Type Aliases ---
+enum class OrderType
+{
+    GoodTillCancel,
+    FillandKill,    // Trades what it can on arrival, the rest is cancelled
+    Market,         // FillandKill with no price limit
+    FillOrKill,     // Fills completely on arrival or is rejected untouched
+    PostOnly,       // Rests like GoodTillCancel but is rejected if it would trade
+    GoodForDay,     // GoodTillCancel until the session end, see Orderbook::SetSessionEnd
+    GoodTillTime    // GoodTillCancel until its expiry, see Orderbook::AdvanceTime
+};
+
+inline const char* ToString(OrderType orderType)
+{
+    switch(orderType)
+    {
+    case OrderType::GoodTillCancel: return "GTC";
+    case OrderType::FillandKill: return "FAK";
+    case OrderType::Market: return "MKT";
+    case OrderType::FillOrKill: return "FOK";
+    case OrderType::PostOnly: return "POST";
+    case OrderType::GoodForDay: return "GFD";
+    case OrderType::GoodTillTime: return "GTT";
+    }
+    return "?";
+}
+
+enum class Side
+{
+    Buy,
+    Sell
+};
+
+using Price = std::int32_t;
+using Quantity = std::int32_t;
+using OrderId = std::int64_t;
+// The session or firm an order belongs to; NoParticipant leaves it unowned
+using ParticipantId = std::uint32_t;
+constexpr ParticipantId NoParticipant = 0;
+using Timestamp = std::uint64_t;    // Book time in ns, see Orderbook::AdvanceTime
+
+// --- LevelInfo and LevelInfos ---
+struct LevelInfo
+{
+    Price price_;
+    Quantity quantity_;
+    std::uint32_t orderCount_;
+};
+
+using LevelInfos = std::vector<LevelInfo>;
+
+// --- LevelUpdate Struct ---
+// One changed level of an L2 delta feed: the new aggregate of the level at
+// price on side. A quantity of 0 means the level is gone.
+struct LevelUpdate
+{
+    Side side_;
+    Price price_;
+    Quantity quantity_;
+    std::uint32_t orderCount_;
+};
+
+using LevelUpdates = std::vector<LevelUpdate>;
+
+// --- IndicativeUncross Struct ---
+// Where an auction would uncross right now: the price executing the most
+// volume, that volume, and the quantity left unmatched at the price
+// (positive when buying is left over). A volume of 0 means the book does
+// not cross.
+struct IndicativeUncross
+{
+    Price price_;
+    std::int64_t volume_;
+    std::int64_t surplus_;
+};
+
+// --- OrderbookLevelInfos Class ---
+class OrderbookLevelInfos
+{
+public:
+    OrderbookLevelInfos(const LevelInfos& bids, const LevelInfos& asks)
+        : bids_{ bids }
+        , asks_{ asks }
+    {}
+
+    const LevelInfos& GetBids() const { return bids_; }
+    const LevelInfos& GetAsks() const { return asks_; }
+
+private:
+    LevelInfos bids_;
+    LevelInfos asks_;
+};
+
+// --- Order Class ---
+class Order
+{
+public:
+    // expiry is the book time a GoodTillTime order leaves at; other types ignore it
+    Order(OrderType orderType, OrderId orderId, Side side, Price price,Quantity quantity, ParticipantId participant = NoParticipant,
+          Timestamp expiry = 0)
+        : orderId_{ orderId }
+        , price_{ price }
+        , initialQuantity_{ quantity }
+        , remainingQuantity_{ quantity }
+        , participant_{ participant }
+        , orderType_{ orderType }
+        , side_{ side }
+        , expiry_{ expiry }
+    {}
+
+    OrderId GetOrderId() const { return orderId_; }
+    ParticipantId GetParticipant() const { return participant_; }
+    Timestamp GetExpiry() const { return expiry_; }
+    Side GetSide() const { return side_; }
+    Price GetPrice() const { return price_; }
+    OrderType GetOrderType() const { return orderType_; }
+    Quantity GetInitialQuantity() const { return initialQuantity_; }
+    Quantity GetRemainingQuantity() const { return remainingQuantity_; }
+    Quantity GetFilledQuantity() const { return initialQuantity_ - remainingQuantity_; }
+    bool IsFilled() const {return GetRemainingQuantity()==0;}
+    void Fill(Quantity quantity)
+    {
+        if (quantity > remainingQuantity_) {
+            throw std::logic_error("Order (" + std::to_string(GetOrderId()) + ") cannot be filled for more than remaining quantity.");
+        }
+        remainingQuantity_ -= quantity;
+    }
+    // Amends the open quantity down without touching what has already filled
+    void ReduceQuantity(Quantity quantity)
+    {
+        if (quantity > remainingQuantity_) {
+            throw std::logic_error("Order (" + std::to_string(GetOrderId()) + ") cannot be reduced above remaining quantity.");
+        }
+        initialQuantity_ -= remainingQuantity_ - quantity;
+        remainingQuantity_ = quantity;
+    }
+
+private:
+    OrderId orderId_;
+    Price price_;
+    Quantity initialQuantity_;
+    Quantity remainingQuantity_;
+    ParticipantId participant_;
+    OrderType orderType_;
+    Side side_;
+    Timestamp expiry_;
+};
+
+using OrderPointer = std::shared_ptr<Order>;
+using OrderPointers = std::list<OrderPointer>;
+
+// --- OrderModify Class ---
+class OrderModify
+{
+public:
+    OrderModify(OrderId orderId, Side side, Price price, Quantity quantity)
+        : orderId_{ orderId }
+        , side_{ side }
+        , price_{ price }
+        , quantity_{ quantity }
+    {}
+
+    OrderId GetOrderId() const { return orderId_; }
+    Price GetPrice() const { return price_; }
+    Side GetSide() const { return side_; }
+    Quantity GetQuantity() const { return quantity_; }
+
+    Order ToOrder(OrderType type, ParticipantId participant = NoParticipant, Timestamp expiry = 0) const
+    {
+        return Order{ type, GetOrderId(), GetSide(), GetPrice(), GetQuantity(), participant, expiry };
+    }
+
+    OrderPointer ToOrderPointer(OrderType type) const
+    {
+        return std::make_shared<Order>(ToOrder(type));
+    }
+
+private:
+    OrderId orderId_;
+    Side side_;
+    Price price_;
+    Quantity quantity_;
+};
+
+// --- TradeInfo and Trade Class ---
+// One side's view of a trade, kept for callers written against the
+// original bid/ask pair
+struct TradeInfo
+{
+    OrderId orderId_;
+    Price price_;
+    Quantity quantity_;
+};
+
+// A single execution: the resting (maker) order, the incoming (taker)
+// order, the price it traded at (always the maker's), its quantity, the
+// taker's side, and a per-book sequence number counting up from 1. The
+// side rides in the top bit of the sequence word to keep a trade at 32
+// bytes.
+class Trade
+{
+public:
+    Trade(OrderId makerOrderId, OrderId takerOrderId, Price price, Quantity quantity, Side aggressorSide, std::uint64_t sequence)
+        : makerOrderId_{ makerOrderId }
+        , takerOrderId_{ takerOrderId }
+        , sequenceAndSide_{ sequence | (aggressorSide == Side::Sell ? SellBit : 0) }
+        , price_{ price }
+        , quantity_{ quantity }
+    {}
+
+    OrderId GetMakerOrderId() const { return makerOrderId_; }
+    OrderId GetTakerOrderId() const { return takerOrderId_; }
+    Price GetPrice() const { return price_; }
+    Quantity GetQuantity() const { return quantity_; }
+    Side GetAggressorSide() const { return (sequenceAndSide_ & SellBit) ? Side::Sell : Side::Buy; }
+    std::uint64_t GetSequence() const { return sequenceAndSide_ & ~SellBit; }
+
+    OrderId GetBidOrderId() const { return GetAggressorSide() == Side::Buy ? takerOrderId_ : makerOrderId_; }
+    OrderId GetAskOrderId() const { return GetAggressorSide() == Side::Buy ? makerOrderId_ : takerOrderId_; }
+    TradeInfo GetBidTrade() const { return TradeInfo{ GetBidOrderId(), price_, quantity_ }; }
+    TradeInfo GetAskTrade() const { return TradeInfo{ GetAskOrderId(), price_, quantity_ }; }
+
+private:
+    static constexpr std::uint64_t SellBit = std::uint64_t{ 1 } << 63;
+
+    OrderId makerOrderId_;
+    OrderId takerOrderId_;
+    std::uint64_t sequenceAndSide_;
+    Price price_;
+    Quantity quantity_;
+};
+
+using Trades = std::vector<Trade>;
+
+// --- TradeBuffer Class ---
+// Struct-of-arrays trade store: one contiguous column per field, ready to
+// hand to a publisher or analytics code as raw arrays. It is callable with
+// a Trade, so it can be passed anywhere the book takes an OnTrade callback.
+class TradeBuffer
+{
+public:
+    void Reserve(std::size_t capacity)
+    {
+        makerOrderIds_.reserve(capacity);
+        takerOrderIds_.reserve(capacity);
+        prices_.reserve(capacity);
+        quantities_.reserve(capacity);
+        aggressorSides_.reserve(capacity);
+        sequences_.reserve(capacity);
+    }
+
+    void Clear()
+    {
+        makerOrderIds_.clear();
+        takerOrderIds_.clear();
+        prices_.clear();
+        quantities_.clear();
+        aggressorSides_.clear();
+        sequences_.clear();
+    }
+
+    void PushBack(const Trade& trade)
+    {
+        makerOrderIds_.push_back(trade.GetMakerOrderId());
+        takerOrderIds_.push_back(trade.GetTakerOrderId());
+        prices_.push_back(trade.GetPrice());
+        quantities_.push_back(trade.GetQuantity());
+        aggressorSides_.push_back(static_cast<std::uint8_t>(trade.GetAggressorSide()));
+        sequences_.push_back(trade.GetSequence());
+    }
+
+    void operator()(const Trade& trade) { PushBack(trade); }
+
+    std::size_t Size() const { return sequences_.size(); }
+    bool IsEmpty() const { return sequences_.empty(); }
+
+    Trade operator[](std::size_t index) const
+    {
+        return Trade{ makerOrderIds_[index], takerOrderIds_[index], prices_[index], quantities_[index],
+                      static_cast<Side>(aggressorSides_[index]), sequences_[index] };
+    }
+
+    const OrderId* GetMakerOrderIds() const { return makerOrderIds_.data(); }
+    const OrderId* GetTakerOrderIds() const { return takerOrderIds_.data(); }
+    const Price* GetPrices() const { return prices_.data(); }
+    const Quantity* GetQuantities() const { return quantities_.data(); }
+    // Side values as bytes
+    const std::uint8_t* GetAggressorSides() const { return aggressorSides_.data(); }
+    const std::uint64_t* GetSequences() const { return sequences_.data(); }
+
+private:
+    std::vector<OrderId> makerOrderIds_;
+    std::vector<OrderId> takerOrderIds_;
+    std::vector<Price> prices_;
+    std::vector<Quantity> quantities_;
+    std::vector<std::uint8_t> aggressorSides_;
+    std::vector<std::uint64_t> sequences_;
+};
+
+// --- RiskLimits Struct ---
+// Pre-trade limits for one participant; zero leaves a limit off. Open
+// orders and notional count only what rests in the book, notional as
+// price times open quantity. The message rate counts adds and modifies
+// (never cancels) per fixed window of book time.
+struct RiskLimits
+{
+    std::uint32_t maxOpenOrders_{ 0 };
+    std::int64_t maxOpenNotional_{ 0 };
+    std::uint32_t maxMessages_{ 0 };
+    Timestamp messageWindow_{ 1000000000 };
+};
+
+// --- OrderRequest Struct ---
+// One entry of a batch handed to Orderbook::ApplyBatch: an add, a cancel, a
+// modify, a mass cancel, a participant's new risk limits, an auction phase
+// change, a move of the book's time, a new session end or an end-of-day
+// expiry, flattened into a single trivially copyable record.
+enum class RequestType : std::uint8_t
+{
+    Add,
+    Cancel,
+    Modify,
+    CancelRange,        // Orderbook::CancelRange
+    CancelParticipant,  // Orderbook::CancelParticipantOrders
+    SetRiskLimits,      // Orderbook::SetRiskLimits
+    BeginAuction,       // Orderbook::BeginAuction
+    EndAuction,         // Orderbook::EndAuction
+    AdvanceTime,        // Orderbook::AdvanceTime
+    SetSessionEnd,      // Orderbook::SetSessionEnd
+    ExpireGoodForDay    // Orderbook::ExpireGoodForDayOrders
+};
+
+struct OrderRequest
+{
+    RequestType type_;
+    OrderType orderType_;   // Add only
+    Side side_;             // Add, Modify and CancelRange
+    Price price_;           // Add and Modify; CancelRange: the lowest price; SetRiskLimits: maxMessages_; BeginAuction: the reference price
+    Quantity quantity_;     // Add and Modify; SetRiskLimits: maxOpenOrders_
+    OrderId orderId_;       // SetRiskLimits: maxOpenNotional_
+    ParticipantId participant_; // Add, CancelParticipant and SetRiskLimits
+    Timestamp time_;        // Add: the GoodTillTime expiry; SetRiskLimits: messageWindow_; AdvanceTime: the new book time; SetSessionEnd: the session end
+    Price maxPrice_;        // CancelRange: the highest price
+
+    static OrderRequest Add(const Order& order)
+    {
+        return OrderRequest{ RequestType::Add, order.GetOrderType(), order.GetSide(), order.GetPrice(), order.GetRemainingQuantity(), order.GetOrderId(), order.GetParticipant(), order.GetExpiry(), 0 };
+    }
+
+    static OrderRequest Cancel(OrderId orderId)
+    {
+        return OrderRequest{ RequestType::Cancel, OrderType::GoodTillCancel, Side::Buy, 0, 0, orderId, NoParticipant, 0, 0 };
+    }
+
+    static OrderRequest Modify(const OrderModify& orderModify)
+    {
+        return OrderRequest{ RequestType::Modify, OrderType::GoodTillCancel, orderModify.GetSide(), orderModify.GetPrice(), orderModify.GetQuantity(), orderModify.GetOrderId(), NoParticipant, 0, 0 };
+    }
+
+    static OrderRequest CancelRange(Side side, Price minPrice, Price maxPrice)
+    {
+        return OrderRequest{ RequestType::CancelRange, OrderType::GoodTillCancel, side, minPrice, 0, 0, NoParticipant, 0, maxPrice };
+    }
+
+    static OrderRequest CancelAll(Side side)
+    {
+        return CancelRange(side, std::numeric_limits<Price>::min(), std::numeric_limits<Price>::max());
+    }
+
+    static OrderRequest CancelParticipant(ParticipantId participant)
+    {
+        return OrderRequest{ RequestType::CancelParticipant, OrderType::GoodTillCancel, Side::Buy, 0, 0, 0, participant, 0, 0 };
+    }
+
+    static OrderRequest SetRiskLimits(ParticipantId participant, const RiskLimits& limits)
+    {
+        return OrderRequest{ RequestType::SetRiskLimits, OrderType::GoodTillCancel, Side::Buy, static_cast<Price>(limits.maxMessages_),
+                             static_cast<Quantity>(limits.maxOpenOrders_), limits.maxOpenNotional_, participant, limits.messageWindow_, 0 };
+    }
+
+    static OrderRequest BeginAuction(Price referencePrice)
+    {
+        return OrderRequest{ RequestType::BeginAuction, OrderType::GoodTillCancel, Side::Buy, referencePrice, 0, 0, NoParticipant, 0, 0 };
+    }
+
+    static OrderRequest EndAuction()
+    {
+        return OrderRequest{ RequestType::EndAuction, OrderType::GoodTillCancel, Side::Buy, 0, 0, 0, NoParticipant, 0, 0 };
+    }
+
+    static OrderRequest AdvanceTime(Timestamp now)
+    {
+        return OrderRequest{ RequestType::AdvanceTime, OrderType::GoodTillCancel, Side::Buy, 0, 0, 0, NoParticipant, now, 0 };
+    }
+
+    static OrderRequest SetSessionEnd(Timestamp end)
+    {
+        return OrderRequest{ RequestType::SetSessionEnd, OrderType::GoodTillCancel, Side::Buy, 0, 0, 0, NoParticipant, end, 0 };
+    }
+
+    static OrderRequest ExpireGoodForDay()
+    {
+        return OrderRequest{ RequestType::ExpireGoodForDay, OrderType::GoodTillCancel, Side::Buy, 0, 0, 0, NoParticipant, 0, 0 };
+    }
+
+    Order ToOrder() const { return Order{ orderType_, orderId_, side_, price_, quantity_, participant_, time_ }; }
+    OrderModify ToOrderModify() const { return OrderModify{ orderId_, side_, price_, quantity_ }; }
+    RiskLimits ToRiskLimits() const { return RiskLimits{ static_cast<std::uint32_t>(quantity_), orderId_, static_cast<std::uint32_t>(price_), time_ }; }
+};
+
+using OrderRequests = std::vector<OrderRequest>;
+
+// --- OrderPool Class ---
+// Resting orders live in a preallocated slab and are chained into their price
+// level through intrusive prev/next slot indices, so adding, cancelling and
+// filling an order never touches the heap once the slab is warm. The slab is
+// split by temperature: the id, open quantity and next link that a sweep
+// reads per order are packed apart from the rest of the order.
+using OrderSlot = std::uint32_t;
+constexpr OrderSlot InvalidOrderSlot = std::numeric_limits<OrderSlot>::max();
+// ExpiryWheel slot an order is chained into, or none
+using TimerBucket = std::uint16_t;
+constexpr TimerBucket NoTimerBucket = std::numeric_limits<TimerBucket>::max();
+
+// Besides the FIFO head/tail, each level keeps its aggregate open quantity
+// and order count up to date on every add, cancel and fill, so depth
+// snapshots never walk the order queues.
+struct PriceLevel
+{
+    OrderSlot head_{ InvalidOrderSlot };
+    OrderSlot tail_{ InvalidOrderSlot };
+    Quantity totalQuantity_{ 0 };
+    std::uint32_t orderCount_{ 0 };
+    // Last Orderbook message that recorded a level update for this level;
+    // survives the level being emptied and recreated within that message
+    std::uint32_t updateStamp_{ 0 };
+
+    bool IsEmpty() const { return head_ == InvalidOrderSlot; }
+};
+
+static_assert(sizeof(PriceLevel) % sizeof(Quantity) == 0, "Ladder quantities are summed as a strided Quantity array");
+
+// --- ParticipantState Struct ---
+inline std::int64_t Notional(Price price, Quantity quantity)
+{
+    return static_cast<std::int64_t>(price) * quantity;
+}
+
+// Every resting order of one participant, across both sides, chained
+// through the cold half of the pool so they can be pulled in one pass,
+// next to the counters its limits are checked against. The counters are
+// kept up to date as orders rest, fill and cancel, so a check never looks
+// at the orders themselves.
+struct ParticipantState
+{
+    OrderSlot head_{ InvalidOrderSlot };
+    std::uint32_t orderCount_{ 0 };
+    std::int64_t openNotional_{ 0 };
+    RiskLimits limits_{};
+    Timestamp windowStart_{ 0 };
+    std::uint32_t windowMessages_{ 0 };
+};
+
+class OrderPool
+{
+public:
+    // What the matching loop reads and writes for every queue entry it
+    // walks: 16 bytes, so four entries of a level's FIFO share a cache line
+    struct HotNode
+    {
+        OrderId orderId_;
+        Quantity remainingQuantity_;
+        OrderSlot next_;
+    };
+
+    // The rest of a resting order, only touched when it is added,
+    // cancelled, amended or visited as a whole Order
+    struct ColdNode
+    {
+        Price price_;
+        Quantity initialQuantity_;
+        OrderSlot prev_;
+        OrderType orderType_;
+        Side side_;
+        ParticipantId participant_;
+        OrderSlot participantPrev_;
+        OrderSlot participantNext_;
+        OrderSlot timerPrev_;
+        OrderSlot timerNext_;
+        TimerBucket timerBucket_;
+        Timestamp expiry_;          // When it is due to expire, while timerBucket_ is set
+    };
+
+    explicit OrderPool(std::size_t capacity)
+    {
+        hot_.reserve(capacity);
+        cold_.reserve(capacity);
+    }
+
+    HotNode& Hot(OrderSlot slot) { return hot_[slot]; }
+    const HotNode& Hot(OrderSlot slot) const { return hot_[slot]; }
+    ColdNode& Cold(OrderSlot slot) { return cold_[slot]; }
+    const ColdNode& Cold(OrderSlot slot) const { return cold_[slot]; }
+
+    // Reassembles the resting order, filled quantity included
+    Order GetOrder(OrderSlot slot) const
+    {
+        const HotNode& hot = hot_[slot];
+        const ColdNode& cold = cold_[slot];
+        Order order{ cold.orderType_, hot.orderId_, cold.side_, cold.price_, cold.initialQuantity_, cold.participant_,
+                     cold.orderType_ == OrderType::GoodTillTime ? cold.expiry_ : 0 };
+        order.Fill(cold.initialQuantity_ - hot.remainingQuantity_);
+        return order;
+    }
+
+    std::size_t Size() const { return size_; }
+
+    OrderSlot Allocate(const Order& order)
+    {
+        ++size_;
+        HotNode hot{ order.GetOrderId(), order.GetRemainingQuantity(), InvalidOrderSlot };
+        ColdNode cold{ order.GetPrice(), order.GetInitialQuantity(), InvalidOrderSlot, order.GetOrderType(), order.GetSide(),
+                       order.GetParticipant(), InvalidOrderSlot, InvalidOrderSlot, InvalidOrderSlot, InvalidOrderSlot,
+                       NoTimerBucket, 0 };
+        if(freeHead_ != InvalidOrderSlot)
+        {
+            OrderSlot slot = freeHead_;
+            freeHead_ = hot_[slot].next_;
+            hot_[slot] = hot;
+            cold_[slot] = cold;
+            return slot;
+        }
+        if(hot_.size() >= InvalidOrderSlot){
+            throw std::length_error("OrderPool exhausted.");
+        }
+        // Grows past the preallocated capacity rather than failing
+        hot_.push_back(hot);
+        cold_.push_back(cold);
+        return static_cast<OrderSlot>(hot_.size() - 1);
+    }
+
+    void Release(OrderSlot slot)
+    {
+        --size_;
+        hot_[slot].next_ = freeHead_;
+        freeHead_ = slot;
+    }
+
+    // Appends to the back of the level's FIFO (lowest time priority)
+    void PushBack(PriceLevel& level, OrderSlot slot)
+    {
+        HotNode& hot = hot_[slot];
+        cold_[slot].prev_ = level.tail_;
+        hot.next_ = InvalidOrderSlot;
+        level.totalQuantity_ += hot.remainingQuantity_;
+        ++level.orderCount_;
+        if(level.tail_ == InvalidOrderSlot){
+            level.head_ = slot;
+        }
+        else{
+            hot_[level.tail_].next_ = slot;
+        }
+        level.tail_ = slot;
+    }
+
+    void Unlink(PriceLevel& level, OrderSlot slot)
+    {
+        const HotNode& hot = hot_[slot];
+        OrderSlot prev = cold_[slot].prev_;
+        level.totalQuantity_ -= hot.remainingQuantity_;
+        --level.orderCount_;
+        if(prev == InvalidOrderSlot){
+            level.head_ = hot.next_;
+        }
+        else{
+            hot_[prev].next_ = hot.next_;
+        }
+        if(hot.next_ == InvalidOrderSlot){
+            level.tail_ = prev;
+        }
+        else{
+            cold_[hot.next_].prev_ = prev;
+        }
+    }
+
+    // Pushes onto the front; a participant's orders have no priority order,
+    // and a restored book rebuilds its chains in snapshot order
+    void LinkParticipant(ParticipantState& orders, OrderSlot slot)
+    {
+        ColdNode& cold = cold_[slot];
+        cold.participantPrev_ = InvalidOrderSlot;
+        cold.participantNext_ = orders.head_;
+        if(orders.head_ != InvalidOrderSlot){
+            cold_[orders.head_].participantPrev_ = slot;
+        }
+        orders.head_ = slot;
+        ++orders.orderCount_;
+    }
+
+    void UnlinkParticipant(ParticipantState& orders, OrderSlot slot)
+    {
+        const ColdNode& cold = cold_[slot];
+        if(cold.participantPrev_ == InvalidOrderSlot){
+            orders.head_ = cold.participantNext_;
+        }
+        else{
+            cold_[cold.participantPrev_].participantNext_ = cold.participantNext_;
+        }
+        if(cold.participantNext_ != InvalidOrderSlot){
+            cold_[cold.participantNext_].participantPrev_ = cold.participantPrev_;
+        }
+        --orders.orderCount_;
+    }
+
+    // Pushes onto the front of an ExpiryWheel slot's chain
+    void LinkTimer(OrderSlot& head, OrderSlot slot, TimerBucket bucket)
+    {
+        ColdNode& cold = cold_[slot];
+        cold.timerBucket_ = bucket;
+        cold.timerPrev_ = InvalidOrderSlot;
+        cold.timerNext_ = head;
+        if(head != InvalidOrderSlot){
+            cold_[head].timerPrev_ = slot;
+        }
+        head = slot;
+    }
+
+    void UnlinkTimer(OrderSlot& head, OrderSlot slot)
+    {
+        ColdNode& cold = cold_[slot];
+        if(cold.timerPrev_ == InvalidOrderSlot){
+            head = cold.timerNext_;
+        }
+        else{
+            cold_[cold.timerPrev_].timerNext_ = cold.timerNext_;
+        }
+        if(cold.timerNext_ != InvalidOrderSlot){
+            cold_[cold.timerNext_].timerPrev_ = cold.timerPrev_;
+        }
+        cold.timerBucket_ = NoTimerBucket;
+    }
+
+private:
+    // Parallel arrays indexed by slot; the free list is chained through hot next_
+    std::vector<HotNode> hot_;
+    std::vector<ColdNode> cold_;
+    OrderSlot freeHead_{ InvalidOrderSlot };
+    std::size_t size_{ 0 };
+};
+
+static_assert(sizeof(OrderPool::HotNode) == 16, "Four hot queue entries per cache line");
+
+// --- ExpiryWheel Class ---
+// Hierarchical timing wheel of the orders due to leave the book at a time.
+// Time is cut into ticks of a fixed width and an order is due at the first
+// tick at or after its expiry, so it never leaves early and at most one
+// tick late. Eight levels of 256 slots cover every 64-bit tick: an order
+// sits at the lowest level where its tick agrees with the current one on
+// all higher digits, chained through the cold half of the pool. Occupancy
+// bitmaps find the next slot due, so advancing skips empty stretches of
+// time in a few word scans, and an order moves down at most once per level
+// before it fires, which keeps the work per expired order O(1) amortised.
+// An expiry that is already past when scheduled goes to an overdue chain
+// that every Advance empties first, so it leaves at the very next advance.
+// GoodForDay orders share one more chain, the day, that has no time of its
+// own: the book fires it whole at the session end.
+class ExpiryWheel
+{
+public:
+    explicit ExpiryWheel(Timestamp tickWidth)
+        : tickWidth_{ std::max<Timestamp>(tickWidth, 1) }
+    {
+        std::fill(std::begin(heads_), std::end(heads_), InvalidOrderSlot);
+        std::fill(&occupied_[0][0], &occupied_[0][0] + Levels * Words, std::uint64_t{ 0 });
+    }
+
+    // Orders waiting on a time, overdue ones included
+    std::size_t Size() const { return size_; }
+    // Orders in the day chain
+    std::size_t DayCount() const { return dayCount_; }
+
+    // Due at expiry; an expiry already past fires at the next Advance
+    void Schedule(OrderPool& pool, OrderSlot slot, Timestamp expiry)
+    {
+        pool.Cold(slot).expiry_ = expiry;
+        std::uint64_t tick = TickOf(expiry);
+        if(tick <= current_){
+            pool.LinkTimer(heads_[OverdueBucket], slot, OverdueBucket);
+        }
+        else{
+            Place(pool, slot, tick);
+        }
+        ++size_;
+    }
+
+    void ScheduleDay(OrderPool& pool, OrderSlot slot)
+    {
+        pool.LinkTimer(heads_[DayBucket], slot, DayBucket);
+        ++dayCount_;
+    }
+
+    void Unschedule(OrderPool& pool, OrderSlot slot)
+    {
+        TimerBucket bucket = pool.Cold(slot).timerBucket_;
+        pool.UnlinkTimer(heads_[bucket], slot);
+        if(bucket == DayBucket){
+            --dayCount_;
+            return;
+        }
+        if(bucket != OverdueBucket && heads_[bucket] == InvalidOrderSlot){
+            occupied_[bucket / Slots][bucket % Slots / 64] &= ~(std::uint64_t{ 1 } << (bucket % 64));
+        }
+        --size_;
+    }
+
+    // Moves to the tick now falls in and calls expire(slot) for every
+    // order due by then, already unscheduled. Returns how many there were.
+    template<typename F>
+    std::size_t Advance(OrderPool& pool, Timestamp now, F&& expire)
+    {
+        std::uint64_t target = now / tickWidth_;
+        std::size_t expired = FireChain(pool, OverdueBucket, expire);
+        size_ -= expired;
+        while(current_ < target){
+            std::uint64_t next = 0;
+            if(size_ == 0 || !FindNextTick(next) || next > target){
+                current_ = target;
+                break;
+            }
+            current_ = next;
+            // The next tick either fires a level 0 slot or opens a slot of
+            // a higher level, whose orders move down before anything fires
+            for(unsigned level = Levels - 1; level > 0; --level){
+                if((current_ & ((std::uint64_t{ 1 } << (SlotBits * level)) - 1)) == 0){
+                    Cascade(pool, level);
+                }
+            }
+            expired += Fire(pool, expire);
+        }
+        return expired;
+    }
+
+    // Moves an empty wheel to the tick now falls in without firing
+    // anything, for rebuilding a book's expiries at its snapshot time
+    void RestoreTime(Timestamp now)
+    {
+        if(size_ != 0 || dayCount_ != 0){
+            throw std::logic_error("Only an empty expiry wheel can be moved to a new time.");
+        }
+        current_ = now / tickWidth_;
+    }
+
+    // Calls expire(slot) for every order in the day chain, already
+    // unscheduled, and returns how many there were
+    template<typename F>
+    std::size_t ExpireDay(OrderPool& pool, F&& expire)
+    {
+        std::size_t expired = FireChain(pool, DayBucket, expire);
+        dayCount_ -= expired;
+        return expired;
+    }
+
+private:
+    static constexpr unsigned SlotBits = 8;
+    static constexpr unsigned Levels = 8;
+    static constexpr std::size_t Slots = std::size_t{ 1 } << SlotBits;
+    static constexpr std::size_t Words = Slots / 64;
+    // The two chains past the wheel's own slots
+    static constexpr TimerBucket DayBucket = Levels * Slots;
+    static constexpr TimerBucket OverdueBucket = Levels * Slots + 1;
+
+    std::uint64_t TickOf(Timestamp expiry) const
+    {
+        return expiry / tickWidth_ + (expiry % tickWidth_ != 0 ? 1 : 0);
+    }
+
+    std::size_t IndexAt(std::uint64_t tick, unsigned level) const
+    {
+        return static_cast<std::size_t>(tick >> (SlotBits * level)) & (Slots - 1);
+    }
+
+    // The digits of the current tick above level, as a tick
+    std::uint64_t BaseAbove(unsigned level) const
+    {
+        if(level + 1 == Levels){
+            return 0;
+        }
+        unsigned shift = SlotBits * (level + 1);
+        return current_ >> shift << shift;
+    }
+
+    // tick must not be before the current one
+    void Place(OrderPool& pool, OrderSlot slot, std::uint64_t tick)
+    {
+        unsigned level = 0;
+        while(level + 1 < Levels && tick >> (SlotBits * (level + 1)) != current_ >> (SlotBits * (level + 1))){
+            ++level;
+        }
+        std::size_t index = IndexAt(tick, level);
+        std::size_t bucket = level * Slots + index;
+        pool.LinkTimer(heads_[bucket], slot, static_cast<TimerBucket>(bucket));
+        occupied_[level][index / 64] |= std::uint64_t{ 1 } << (index % 64);
+    }
+
+    // Every order sits past the current tick's slot of its level and within
+    // the current slot of the level above, so the lowest level with a later
+    // slot occupied holds the next tick anything happens at
+    bool FindNextTick(std::uint64_t& tick) const
+    {
+        for(unsigned level = 0; level < Levels; ++level){
+            std::size_t from = IndexAt(current_, level) + 1;
+            for(std::size_t word = from / 64; word < Words; ++word){
+                std::uint64_t bits = occupied_[level][word];
+                if(word == from / 64){
+                    bits &= ~std::uint64_t{ 0 } << (from % 64);
+                }
+                if(bits){
+                    std::size_t index = word * 64 + static_cast<std::size_t>(__builtin_ctzll(bits));
+                    tick = BaseAbove(level) | static_cast<std::uint64_t>(index) << (SlotBits * level);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Takes a slot's whole chain off the wheel
+    OrderSlot Detach(unsigned level, std::size_t index)
+    {
+        std::size_t bucket = level * Slots + index;
+        OrderSlot head = heads_[bucket];
+        heads_[bucket] = InvalidOrderSlot;
+        occupied_[level][index / 64] &= ~(std::uint64_t{ 1 } << (index % 64));
+        return head;
+    }
+
+    // Redistributes the slot of level the current tick just entered
+    void Cascade(OrderPool& pool, unsigned level)
+    {
+        OrderSlot slot = Detach(level, IndexAt(current_, level));
+        while(slot != InvalidOrderSlot){
+            const OrderPool::ColdNode& cold = pool.Cold(slot);
+            OrderSlot next = cold.timerNext_;
+            Place(pool, slot, std::max(TickOf(cold.expiry_), current_));
+            slot = next;
+        }
+    }
+
+    template<typename F>
+    std::size_t Fire(OrderPool& pool, F& expire)
+    {
+        std::size_t expired = ExpireChain(pool, Detach(0, IndexAt(current_, 0)), expire);
+        size_ -= expired;
+        return expired;
+    }
+
+    // Empties one of the chains Detach does not cover
+    template<typename F>
+    std::size_t FireChain(OrderPool& pool, TimerBucket bucket, F& expire)
+    {
+        OrderSlot head = heads_[bucket];
+        heads_[bucket] = InvalidOrderSlot;
+        return ExpireChain(pool, head, expire);
+    }
+
+    template<typename F>
+    std::size_t ExpireChain(OrderPool& pool, OrderSlot slot, F& expire)
+    {
+        std::size_t expired = 0;
+        while(slot != InvalidOrderSlot){
+            OrderPool::ColdNode& cold = pool.Cold(slot);
+            OrderSlot next = cold.timerNext_;
+            cold.timerBucket_ = NoTimerBucket;
+            expire(slot);
+            ++expired;
+            slot = next;
+        }
+        return expired;
+    }
+
+    Timestamp tickWidth_;
+    std::uint64_t current_{ 0 };   // Every tick up to this one has fired
+    std::size_t size_{ 0 };
+    std::size_t dayCount_{ 0 };
+    OrderSlot heads_[Levels * Slots + 2];
+    std::uint64_t occupied_[Levels][Words];
+};
+
+// --- PriceLevels Class ---
+// One side of the book. Prices inside a configurable tick band around a
+// reference price map straight onto a contiguous array of levels, with an
+// occupancy bitmap to find the next non-empty level and a tracked best
+// index. Prices outside the band (or all prices, when the band is empty)
+// fall back to an ordered map. Compare orders prices best-first, exactly
+// as the old std::map comparator did.
+template<typename Compare>
+class PriceLevels
+{
+public:
+    PriceLevels(Price referencePrice, Price ladderTicks)
+        : kernels_{ detail::GetSimdKernels() }
+    {
+        if(ladderTicks > 0){
+            std::size_t count = static_cast<std::size_t>(ladderTicks) * 2 + 1;
+            minPrice_ = referencePrice - ladderTicks;
+            ladder_.resize(count);
+            occupied_.resize((count + 63) / 64);
+        }
+    }
+
+    bool IsEmpty() const { return bestIndex_ == NoIndex && overflow_.empty(); }
+
+    std::size_t GetLevelCount() const { return ladderLevelCount_ + overflow_.size(); }
+
+    Price GetBestPrice() const
+    {
+        return IsOverflowBest() ? overflow_.begin()->first : PriceAt(bestIndex_);
+    }
+
+    PriceLevel& GetBestLevel()
+    {
+        return IsOverflowBest() ? overflow_.begin()->second : ladder_[bestIndex_];
+    }
+
+    const PriceLevel& GetBestLevel() const
+    {
+        return IsOverflowBest() ? overflow_.begin()->second : ladder_[bestIndex_];
+    }
+
+    PriceLevel& GetOrCreateLevel(Price price)
+    {
+        std::size_t index;
+        if(!TryGetIndex(price, index)){
+            auto level = overflow_.emplace(price, PriceLevel{});
+            if(level.second && !erasedStamps_.empty()){
+                auto erased = erasedStamps_.find(price);
+                if(erased != erasedStamps_.end()){
+                    level.first->second.updateStamp_ = erased->second;
+                }
+            }
+            return level.first->second;
+        }
+        if(!IsOccupied(index)){
+            occupied_[index / 64] |= std::uint64_t{ 1 } << (index % 64);
+            std::uint32_t updateStamp = ladder_[index].updateStamp_;
+            ladder_[index] = PriceLevel{};
+            ladder_[index].updateStamp_ = updateStamp;
+            ++ladderLevelCount_;
+            if(bestIndex_ == NoIndex || Compare{}(price, PriceAt(bestIndex_))){
+                bestIndex_ = index;
+            }
+        }
+        return ladder_[index];
+    }
+
+    PriceLevel* FindLevel(Price price)
+    {
+        std::size_t index;
+        if(!TryGetIndex(price, index)){
+            auto level = overflow_.find(price);
+            return level == overflow_.end() ? nullptr : &level->second;
+        }
+        return IsOccupied(index) ? &ladder_[index] : nullptr;
+    }
+
+    // Drops an (empty) level; if it was the best, the bitmap is scanned
+    // for the next non-empty level on the worse side.
+    void EraseLevel(Price price)
+    {
+        std::size_t index;
+        if(!TryGetIndex(price, index)){
+            auto level = overflow_.find(price);
+            if(level->second.updateStamp_ != 0){
+                erasedStamps_[price] = level->second.updateStamp_;
+            }
+            overflow_.erase(level);
+            return;
+        }
+        occupied_[index / 64] &= ~(std::uint64_t{ 1 } << (index % 64));
+        --ladderLevelCount_;
+        if(index == bestIndex_){
+            bestIndex_ = NextWorse(index);
+        }
+    }
+
+    // Drops every level priced in [minPrice, maxPrice] at once, calling
+    // f(price, level) on each best first just before it goes. Ladder words
+    // are cleared wholesale and the best level is rescanned at most once.
+    template<typename F>
+    void EraseLevels(Price minPrice, Price maxPrice, F f)
+    {
+        if(minPrice > maxPrice){
+            return;
+        }
+        // Map order is best first: the range starts at whichever bound is better
+        auto first = overflow_.lower_bound(BestIsHighest ? maxPrice : minPrice);
+        auto last = overflow_.upper_bound(BestIsHighest ? minPrice : maxPrice);
+        // Overflow prices are all outside the band, so any ladder price
+        // splits the range into the levels ahead of the ladder and behind it
+        auto behind = first;
+        if(!ladder_.empty()){
+            for(; behind != last && Compare{}(behind->first, PriceAt(0)); ++behind){
+                f(behind->first, behind->second);
+            }
+        }
+        EraseLadderLevels(minPrice, maxPrice, f);
+        for(auto level = behind; level != last; ++level){
+            f(level->first, level->second);
+        }
+        overflow_.erase(first, last);
+    }
+
+    // Visits up to maxLevels levels best-first as f(price, level)
+    template<typename F>
+    void ForEachLevel(F f, std::size_t maxLevels = NoIndex) const
+    {
+        if(maxLevels == 0){
+            return;
+        }
+        ForEachLevelWhile([&](Price price, const PriceLevel& level){
+            f(price, level);
+            return --maxLevels != 0;
+        });
+    }
+
+    // Visits levels best to worst as f(price, level) for as long as f
+    // returns true
+    template<typename F>
+    void ForEachLevelWhile(F f) const
+    {
+        auto overflow = overflow_.begin();
+        if(bestIndex_ != NoIndex){
+            // Overflow prices are all outside the band, so any ladder price
+            // splits them into the ones ahead of the ladder and the ones behind.
+            Price bandPrice = PriceAt(bestIndex_);
+            for(; overflow != overflow_.end() && Compare{}(overflow->first, bandPrice); ++overflow){
+                if(!f(overflow->first, overflow->second)){
+                    return;
+                }
+            }
+            for(std::size_t index = bestIndex_; index != NoIndex; index = NextWorse(index)){
+                if(!f(PriceAt(index), ladder_[index])){
+                    return;
+                }
+            }
+        }
+        for(; overflow != overflow_.end(); ++overflow){
+            if(!f(overflow->first, overflow->second)){
+                return;
+            }
+        }
+    }
+
+    // Total quantity resting at price or better, counting no further once
+    // it reaches limit. Ladder levels are summed as a dense range: a ladder
+    // slot that is not occupied always holds zero quantity, because a level
+    // is only erased after its last order has been unlinked or, in bulk by
+    // EraseLevels, reset outright.
+    std::int64_t GetQuantityThrough(Price price, std::int64_t limit = std::numeric_limits<std::int64_t>::max()) const
+    {
+        std::int64_t total = 0;
+        auto overflow = overflow_.begin();
+        auto sumOverflow = [&](bool aheadOfLadder){
+            for(; overflow != overflow_.end() && total < limit && !Compare{}(price, overflow->first); ++overflow){
+                if(aheadOfLadder && bestIndex_ != NoIndex && !Compare{}(overflow->first, PriceAt(bestIndex_))){
+                    return;
+                }
+                total += overflow->second.totalQuantity_;
+            }
+        };
+        sumOverflow(true);
+        if(bestIndex_ != NoIndex && total < limit && !Compare{}(price, PriceAt(bestIndex_))){
+            // Ladder indices from the best level up to price, clamped to the band
+            std::int64_t offset = static_cast<std::int64_t>(price) - minPrice_;
+            std::size_t first = bestIndex_;
+            std::size_t last = bestIndex_;
+            if(BestIsHighest){
+                first = offset <= 0 ? 0 : static_cast<std::size_t>(offset);
+            }
+            else{
+                last = std::min(static_cast<std::size_t>(offset), ladder_.size() - 1);
+            }
+            constexpr std::size_t Stride = sizeof(PriceLevel) / sizeof(Quantity);
+            for(std::size_t chunk = first; chunk <= last && total < limit; chunk += QuantitySumChunk){
+                std::size_t count = std::min(QuantitySumChunk, last - chunk + 1);
+                total += SumStrided(&ladder_[chunk].totalQuantity_, Stride, count);
+            }
+        }
+        sumOverflow(false);
+        return total;
+    }
+
+    // Marks every level as not yet recorded by any message
+    void ClearUpdateStamps()
+    {
+        for(auto& level : ladder_){
+            level.updateStamp_ = 0;
+        }
+        for(auto& level : overflow_){
+            level.second.updateStamp_ = 0;
+        }
+        erasedStamps_.clear();
+    }
+
+    // Drops the stamps of overflow levels erased before the current message
+    void ForgetErasedLevels()
+    {
+        erasedStamps_.clear();
+    }
+
+private:
+    static constexpr std::size_t NoIndex = std::numeric_limits<std::size_t>::max();
+    // Ladder levels summed between limit checks in GetQuantityThrough
+    static constexpr std::size_t QuantitySumChunk = 256;
+    // True for bids (std::greater), where the best level is the highest index
+    static constexpr bool BestIsHighest = Compare{}(1, 0);
+
+    // The ladder part of EraseLevels, words visited from the best end
+    template<typename F>
+    void EraseLadderLevels(Price minPrice, Price maxPrice, F& f)
+    {
+        std::int64_t low = std::max<std::int64_t>(static_cast<std::int64_t>(minPrice) - minPrice_, 0);
+        std::int64_t high = std::min<std::int64_t>(static_cast<std::int64_t>(maxPrice) - minPrice_,
+                                                   static_cast<std::int64_t>(ladder_.size()) - 1);
+        if(low > high || bestIndex_ == NoIndex){
+            return;
+        }
+        std::size_t lowIndex = static_cast<std::size_t>(low);
+        std::size_t highIndex = static_cast<std::size_t>(high);
+        std::size_t wordCount = highIndex / 64 - lowIndex / 64 + 1;
+        for(std::size_t step = 0; step < wordCount; ++step){
+            std::size_t word = BestIsHighest ? highIndex / 64 - step : lowIndex / 64 + step;
+            std::uint64_t mask = ~std::uint64_t{ 0 };
+            if(word == lowIndex / 64){
+                mask &= ~std::uint64_t{ 0 } << (lowIndex % 64);
+            }
+            if(word == highIndex / 64){
+                mask &= ~std::uint64_t{ 0 } >> (63 - highIndex % 64);
+            }
+            std::uint64_t bits = occupied_[word] & mask;
+            ladderLevelCount_ -= static_cast<std::size_t>(__builtin_popcountll(bits));
+            occupied_[word] &= ~mask;
+            while(bits != 0){
+                std::size_t bit = BestIsHighest ? 63 - static_cast<std::size_t>(__builtin_clzll(bits))
+                                                : static_cast<std::size_t>(__builtin_ctzll(bits));
+                bits &= ~(std::uint64_t{ 1 } << bit);
+                std::size_t index = word * 64 + bit;
+                f(PriceAt(index), ladder_[index]);
+                ladder_[index] = PriceLevel{};
+            }
+        }
+        if(bestIndex_ >= lowIndex && bestIndex_ <= highIndex){
+            if(BestIsHighest){
+                bestIndex_ = lowIndex == 0 ? NoIndex : ScanDown(lowIndex - 1);
+            }
+            else{
+                bestIndex_ = ScanUp(highIndex + 1);
+            }
+        }
+    }
+
+    Price PriceAt(std::size_t index) const { return minPrice_ + static_cast<Price>(index); }
+
+    bool TryGetIndex(Price price, std::size_t& index) const
+    {
+        std::int64_t offset = static_cast<std::int64_t>(price) - minPrice_;
+        if(offset < 0 || offset >= static_cast<std::int64_t>(ladder_.size())){
+            return false;
+        }
+        index = static_cast<std::size_t>(offset);
+        return true;
+    }
+
+    bool IsOccupied(std::size_t index) const
+    {
+        return (occupied_[index / 64] >> (index % 64)) & 1;
+    }
+
+    bool IsOverflowBest() const
+    {
+        if(overflow_.empty()){
+            return false;
+        }
+        return bestIndex_ == NoIndex || Compare{}(overflow_.begin()->first, PriceAt(bestIndex_));
+    }
+
+    std::size_t NextWorse(std::size_t index) const
+    {
+        if(BestIsHighest){
+            return index == 0 ? NoIndex : ScanDown(index - 1);
+        }
+        return ScanUp(index + 1);
+    }
+
+    // Lowest occupied index >= index
+    std::size_t ScanUp(std::size_t index) const
+    {
+        std::size_t word = index / 64;
+        if(word >= occupied_.size()){
+            return NoIndex;
+        }
+        std::uint64_t bits = occupied_[word] & (~std::uint64_t{ 0 } << (index % 64));
+        if(bits == 0){
+            std::size_t rest = occupied_.size() - word - 1;
+            std::size_t found = kernels_.findFirstNonZeroWord_(occupied_.data() + word + 1, rest);
+            if(found == rest){
+                return NoIndex;
+            }
+            word += 1 + found;
+            bits = occupied_[word];
+        }
+        return word * 64 + static_cast<std::size_t>(__builtin_ctzll(bits));
+    }
+
+    // Highest occupied index <= index
+    std::size_t ScanDown(std::size_t index) const
+    {
+        std::size_t word = index / 64;
+        std::uint64_t bits = occupied_[word] & (~std::uint64_t{ 0 } >> (63 - index % 64));
+        if(bits == 0){
+            std::size_t found = kernels_.findLastNonZeroWord_(occupied_.data(), word);
+            if(found == word){
+                return NoIndex;
+            }
+            word = found;
+            bits = occupied_[word];
+        }
+        return word * 64 + 63 - static_cast<std::size_t>(__builtin_clzll(bits));
+    }
+
+    Price minPrice_{ 0 };
+    std::vector<PriceLevel> ladder_;
+    std::vector<std::uint64_t> occupied_;
+    std::size_t bestIndex_{ NoIndex };
+    std::size_t ladderLevelCount_{ 0 };
+    std::map<Price, PriceLevel, Compare> overflow_;
+    // Update stamps of overflow levels erased during the current message,
+    // handed back if the same price is recreated before it ends
+    std::map<Price, std::uint32_t> erasedStamps_;
+    // Word scan kernels, resolved once here so a scan is one indirect call
+    detail::SimdKernels kernels_;
+};
+
+template<typename Compare>
+constexpr std::size_t PriceLevels<Compare>::NoIndex;
+
+template<typename Compare>
+constexpr bool PriceLevels<Compare>::BestIsHighest;
+
+template<typename Compare>
+constexpr std::size_t PriceLevels<Compare>::QuantitySumChunk;
+
+// --- OrderIndex Class ---
+// Maps OrderId to the slot of a resting order. Hashed mode is a flat
+// linear-probing table (power-of-two capacity, kept at most half full,
+// backward-shift deletion so there are no tombstones). Direct mode is a
+// power-of-two ring indexed by orderId - baseOrderId for gateways that
+// hand out dense, increasing ids: each entry keeps its id, so the ring
+// follows the ids forward through the session. An id that finds its ring
+// entry taken doubles the ring, up to 16M entries; past that the older
+// order moves to the hashed table. Ids below the base are hashed too.
+// Find returns the entry itself so callers can erase it without probing
+// a second time.
+enum class OrderIndexMode
+{
+    Hashed,
+    Direct
+};
+
+class OrderIndex
+{
+public:
+    struct Entry
+    {
+        OrderId orderId_{ 0 };
+        OrderSlot slot_{ InvalidOrderSlot }; // InvalidOrderSlot marks a free entry
+    };
+
+    OrderIndex(OrderIndexMode mode, std::size_t capacity, OrderId baseOrderId)
+        : mode_{ mode }
+        , baseOrderId_{ baseOrderId }
+    {
+        if(mode_ == OrderIndexMode::Direct){
+            std::size_t size = 1;
+            while(size < capacity && size < MaxDirectSpan){
+                size *= 2;
+            }
+            direct_.resize(size);
+        }
+        else{
+            Rehash(capacity * 2);
+        }
+    }
+
+    std::size_t Size() const { return size_; }
+
+    Entry* Find(OrderId orderId)
+    {
+        std::size_t offset;
+        if(TryGetDirectOffset(orderId, offset)){
+            Entry& entry = direct_[offset & (direct_.size() - 1)];
+            if(entry.slot_ != InvalidOrderSlot && entry.orderId_ == orderId){
+                return &entry;
+            }
+            if(hashedSize_ == 0){
+                return nullptr;
+            }
+        }
+        if(table_.empty()){
+            return nullptr;
+        }
+        std::size_t mask = table_.size() - 1;
+        for(std::size_t pos = Home(orderId); ; pos = (pos + 1) & mask){
+            Entry& entry = table_[pos];
+            if(entry.slot_ == InvalidOrderSlot){
+                return nullptr;
+            }
+            if(entry.orderId_ == orderId){
+                return &entry;
+            }
+        }
+    }
+
+    // The caller guarantees orderId is not already present
+    void Insert(OrderId orderId, OrderSlot slot)
+    {
+        ++size_;
+        std::size_t offset;
+        if(TryGetDirectOffset(orderId, offset)){
+            for(;;){
+                Entry& entry = direct_[offset & (direct_.size() - 1)];
+                if(entry.slot_ == InvalidOrderSlot){
+                    entry = Entry{ orderId, slot };
+                    return;
+                }
+                if(direct_.size() < MaxDirectSpan){
+                    GrowDirect();
+                    continue;
+                }
+                // A full-size ring keeps the newer id; the order it
+                // displaces has been resting for 16M ids and is hashed
+                InsertHashed(entry.orderId_, entry.slot_);
+                entry = Entry{ orderId, slot };
+                return;
+            }
+        }
+        InsertHashed(orderId, slot);
+    }
+
+    // entry must come from Find and not have been invalidated by an Insert
+    void Erase(Entry* entry)
+    {
+        --size_;
+        if(!direct_.empty() && entry >= direct_.data() && entry < direct_.data() + direct_.size()){
+            entry->slot_ = InvalidOrderSlot;
+            return;
+        }
+        --hashedSize_;
+        // Shift later members of the probe run back into the hole so that
+        // lookups never need tombstones.
+        std::size_t mask = table_.size() - 1;
+        std::size_t hole = static_cast<std::size_t>(entry - table_.data());
+        for(std::size_t pos = (hole + 1) & mask; table_[pos].slot_ != InvalidOrderSlot; pos = (pos + 1) & mask){
+            std::size_t home = Home(table_[pos].orderId_);
+            if(((pos - home) & mask) >= ((pos - hole) & mask)){
+                table_[hole] = table_[pos];
+                hole = pos;
+            }
+        }
+        table_[hole].slot_ = InvalidOrderSlot;
+    }
+
+    // Pulls the cache line the lookup for orderId will probe first
+    void Prefetch(OrderId orderId) const
+    {
+        std::size_t offset;
+        if(TryGetDirectOffset(orderId, offset)){
+            __builtin_prefetch(&direct_[offset & (direct_.size() - 1)]);
+        }
+        else if(!table_.empty()){
+            __builtin_prefetch(&table_[Home(orderId)]);
+        }
+    }
+
+    void Erase(OrderId orderId)
+    {
+        if(Entry* entry = Find(orderId)){
+            Erase(entry);
+        }
+    }
+
+private:
+    // Caps the direct ring at 16M entries (256 MiB)
+    static constexpr std::size_t MaxDirectSpan = std::size_t{ 1 } << 24;
+
+    bool TryGetDirectOffset(OrderId orderId, std::size_t& offset) const
+    {
+        if(mode_ != OrderIndexMode::Direct || orderId < baseOrderId_){
+            return false;
+        }
+        offset = static_cast<std::size_t>(static_cast<std::uint64_t>(orderId) - static_cast<std::uint64_t>(baseOrderId_));
+        return true;
+    }
+
+    // Doubles the ring; entries keep their offset modulo the larger size
+    void GrowDirect()
+    {
+        std::vector<Entry> old(direct_.size() * 2);
+        old.swap(direct_);
+        std::size_t mask = direct_.size() - 1;
+        for(const Entry& entry : old){
+            if(entry.slot_ != InvalidOrderSlot){
+                std::size_t offset = static_cast<std::size_t>(static_cast<std::uint64_t>(entry.orderId_) - static_cast<std::uint64_t>(baseOrderId_));
+                direct_[offset & mask] = entry;
+            }
+        }
+    }
+
+    void InsertHashed(OrderId orderId, OrderSlot slot)
+    {
+        if((hashedSize_ + 1) * 2 > table_.size()){
+            Rehash(std::max<std::size_t>(table_.size() * 2, 16));
+        }
+        ++hashedSize_;
+        std::size_t mask = table_.size() - 1;
+        std::size_t pos = Home(orderId);
+        while(table_[pos].slot_ != InvalidOrderSlot){
+            pos = (pos + 1) & mask;
+        }
+        table_[pos] = Entry{ orderId, slot };
+    }
+
+    std::size_t Home(OrderId orderId) const
+    {
+        // Fibonacci hashing spreads sequential ids across the table
+        return static_cast<std::size_t>((static_cast<std::uint64_t>(orderId) * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+
+    void Rehash(std::size_t minimumCapacity)
+    {
+        std::size_t capacity = 16;
+        unsigned bits = 4;
+        while(capacity < minimumCapacity){
+            capacity *= 2;
+            ++bits;
+        }
+        std::vector<Entry> old(capacity);
+        old.swap(table_);
+        shift_ = 64 - bits;
+        std::size_t mask = capacity - 1;
+        for(const Entry& entry : old){
+            if(entry.slot_ == InvalidOrderSlot){
+                continue;
+            }
+            std::size_t pos = Home(entry.orderId_);
+            while(table_[pos].slot_ != InvalidOrderSlot){
+                pos = (pos + 1) & mask;
+            }
+            table_[pos] = entry;
+        }
+    }
+
+    OrderIndexMode mode_;
+    OrderId baseOrderId_;
+    std::vector<Entry> direct_;
+    std::vector<Entry> table_;
+    unsigned shift_{ 64 };
+    std::size_t size_{ 0 };
+    std::size_t hashedSize_{ 0 };
+};
+
+// --- OrderbookConfig Struct ---
+struct OrderbookConfig
+{
+    std::size_t orderCapacity_{ 1 << 16 };
+    // Width of the ladder band on either side of referencePrice_, in ticks.
+    // Zero keeps every level in the map-based fallback.
+    Price referencePrice_{ 0 };
+    Price ladderTicks_{ 0 };
+    // Direct suits gateways assigning dense ids counting up from baseOrderId_
+    OrderIndexMode orderIndexMode_{ OrderIndexMode::Hashed };
+    OrderId baseOrderId_{ 0 };
+    // Collect the levels each call changes, see Orderbook::GetLevelUpdates
+    bool levelUpdates_{ false };
+    // Limits every participant starts with, see Orderbook::SetRiskLimits
+    RiskLimits riskLimits_{};
+    // Keep a running fingerprint of the book, see Orderbook::GetDigest
+    bool digest_{ false };
+    // Granularity of order expiry in ns of book time: an order leaves at
+    // most this long after its expiry, see Orderbook::AdvanceTime
+    Timestamp expiryTick_{ 1000000 };
+};
+
+// --- OrderbookEventSink Interface ---
+// The book reports everything it does through a sink instead of writing to
+// a stream itself, so the matching path never blocks on I/O. Callbacks run
+// synchronously on the thread calling into the book.
+enum class RejectReason
+{
+    DuplicateOrderId,
+    NoImmediateMatch,    // FillandKill that cannot trade on arrival
+    NoLiquidity,         // Market order with an empty opposite side
+    InsufficientLiquidity, // FillOrKill the crossing levels cannot fill in full
+    WouldCross,          // PostOnly that would trade on arrival
+    CancelUnknownOrder,
+    ModifyUnknownOrder,
+    OpenOrderLimit,      // Would take the participant past RiskLimits::maxOpenOrders_
+    NotionalLimit,       // Would take the participant past RiskLimits::maxOpenNotional_
+    MessageRateLimit,    // Participant already sent RiskLimits::maxMessages_ this window
+    InvalidQuantity,     // Add or modify for a quantity of zero or less
+    AuctionInProgress,   // Order type that cannot wait for the uncross (IOC family, PostOnly)
+    AlreadyExpired       // GoodTillTime whose expiry is not after the book time
+};
+
+class OrderbookEventSink
+{
+public:
+    virtual ~OrderbookEventSink() = default;
+
+    virtual void OnOrderAdded(const Order& order) = 0;
+    virtual void OnOrderCancelled(OrderId orderId) = 0;
+    // Called before the amend is applied, while existingOrder is still live
+    virtual void OnOrderModified(const Order& existingOrder, const OrderModify& orderModify) = 0;
+    virtual void OnOrderRejected(OrderId orderId, RejectReason reason) = 0;
+    virtual void OnTrade(const Trade& trade) = 0;
+};
+
+class NullEventSink : public OrderbookEventSink
+{
+public:
+    static NullEventSink& Instance()
+    {
+        static NullEventSink sink;
+        return sink;
+    }
+
+    void OnOrderAdded(const Order&) override {}
+    void OnOrderCancelled(OrderId) override {}
+    void OnOrderModified(const Order&, const OrderModify&) override {}
+    void OnOrderRejected(OrderId, RejectReason) override {}
+    void OnTrade(const Trade&) override {}
+};
+
+// --- SideTraits ---
+// Everything that differs between the two sides of the book, fixed at
+// compile time. Side-specific Orderbook code is written once as a template
+// on Side and dispatched on the order's side a single time at entry.
+template<Side S>
+struct SideTraits;
+
+template<>
+struct SideTraits<Side::Buy>
+{
+    using Compare = std::greater<Price>;   // Highest bid is best
+    using Levels = PriceLevels<Compare>;
+    static constexpr Side Opposite = Side::Sell;
+
+    // True when an order at price trades against the best opposite price
+    static bool Crosses(Price price, Price oppositeBest) { return price >= oppositeBest; }
+};
+
+template<>
+struct SideTraits<Side::Sell>
+{
+    using Compare = std::less<Price>;      // Lowest ask is best
+    using Levels = PriceLevels<Compare>;
+    static constexpr Side Opposite = Side::Buy;
+
+    static bool Crosses(Price price, Price oppositeBest) { return price <= oppositeBest; }
+};
+
+// --- Orderbook Class ---
+class Orderbook
+{
+private:
+    template<Side S>
+    using SideConstant = std::integral_constant<Side, S>;
+
+    OrderPool pool_;
+    SideTraits<Side::Buy>::Levels bids_;
+    SideTraits<Side::Sell>::Levels asks_;
+    OrderIndex orders_;
+    // Only participants that ever sent an order or were given limits;
+    // entries are kept once empty so a reconnecting session keeps its
+    // limits and does not reallocate
+    std::unordered_map<ParticipantId, ParticipantState> participants_;
+    RiskLimits defaultRiskLimits_;
+    Timestamp now_{ 0 };
+    std::vector<OrderSlot> participantSlots_;   // Scratch for CancelParticipantOrders
+    // GoodTillTime orders, and GoodForDay ones once a session end is set
+    ExpiryWheel expiries_;
+    Timestamp sessionEnd_{ 0 };
+
+    // During an auction orders rest without matching, so the book may
+    // cross, until EndAuction uncrosses it once. The indicative uncross is
+    // cached and only goes stale when a level inside the crossed range
+    // changes; the scratch level lists are kept to avoid reallocating.
+    bool auctionPhase_{ false };
+    Price auctionReferencePrice_{ 0 };
+    mutable bool indicativeStale_{ false };
+    mutable IndicativeUncross indicative_{ 0, 0, 0 };
+    mutable LevelInfos auctionBids_;
+    mutable LevelInfos auctionAsks_;
+    OrderbookEventSink* sink_{ &NullEventSink::Instance() };
+    std::uint64_t tradeSequence_{ 0 };   // Sequence of the last trade
+
+    // While a message is being applied, levelUpdates_ holds each touched
+    // level's aggregate from before the message; when it ends the entries
+    // are rewritten in place to the new aggregates.
+    bool levelUpdatesEnabled_;
+    bool recordingLevelUpdates_{ false };
+    std::uint32_t levelUpdateStamp_{ 0 };
+    LevelUpdates levelUpdates_;
+
+    // The digest is a wrapping sum of one term per resting order, so each
+    // change subtracts the terms it invalidates and adds their successors.
+    // A term covers the order's id, side, price and open quantity and the
+    // id of the order queued ahead of it, which fixes queue order without
+    // positions that would shift on every fill.
+    bool digestEnabled_;
+    std::uint64_t digest_{ 0 };
+
+    static constexpr std::size_t BatchPrefetchDistance = 4;
+
+#if ORDERBOOK_INSTRUMENTATION
+    OrderbookInstrumentation instrumentation_;
+#endif
+
+    SideTraits<Side::Buy>::Levels& LevelsOf(SideConstant<Side::Buy>) { return bids_; }
+    SideTraits<Side::Sell>::Levels& LevelsOf(SideConstant<Side::Sell>) { return asks_; }
+    const SideTraits<Side::Buy>::Levels& LevelsOf(SideConstant<Side::Buy>) const { return bids_; }
+    const SideTraits<Side::Sell>::Levels& LevelsOf(SideConstant<Side::Sell>) const { return asks_; }
+
+    template<Side S>
+    typename SideTraits<S>::Levels& Levels() { return LevelsOf(SideConstant<S>{}); }
+
+    template<Side S>
+    const typename SideTraits<S>::Levels& Levels() const { return LevelsOf(SideConstant<S>{}); }
+
+    template<Side S>
+    bool CanMatch(Price price)const
+    {
+        const auto& opposite = Levels<SideTraits<S>::Opposite>();
+        return !opposite.IsEmpty() && SideTraits<S>::Crosses(price, opposite.GetBestPrice());
+    }
+
+    bool CanMatch(Side side, Price price)const
+    {
+        return side == Side::Buy ? CanMatch<Side::Buy>(price) : CanMatch<Side::Sell>(price);
+    }
+
+    // Brackets one public call. Only the outermost scope records, so a
+    // modify that cancels and re-adds still yields a single set of updates.
+    class LevelUpdateScope
+    {
+    public:
+        explicit LevelUpdateScope(Orderbook& orderbook)
+            : orderbook_{ orderbook }
+            , active_{ orderbook.levelUpdatesEnabled_ && !orderbook.recordingLevelUpdates_ }
+        {
+            if(active_){
+                orderbook_.BeginLevelUpdates();
+            }
+        }
+
+        ~LevelUpdateScope()
+        {
+            if(active_){
+                orderbook_.FinishLevelUpdates();
+            }
+        }
+
+        LevelUpdateScope(const LevelUpdateScope&) = delete;
+        LevelUpdateScope& operator=(const LevelUpdateScope&) = delete;
+
+    private:
+        Orderbook& orderbook_;
+        bool active_;
+    };
+
+    void BeginLevelUpdates()
+    {
+        levelUpdates_.clear();
+        bids_.ForgetErasedLevels();
+        asks_.ForgetErasedLevels();
+        if(++levelUpdateStamp_ == 0){
+            // Wrapped: no level may still carry a stamp from 2^32 messages ago
+            bids_.ClearUpdateStamps();
+            asks_.ClearUpdateStamps();
+            levelUpdateStamp_ = 1;
+        }
+        recordingLevelUpdates_ = true;
+    }
+
+    // Must be called before level's aggregate changes. Also where an
+    // auction notices that a change can move its uncross.
+    template<Side S>
+    void RecordLevelUpdate(Price price, PriceLevel& level)
+    {
+        if(auctionPhase_ && !indicativeStale_ && CanMatch<S>(price)){
+            // Only levels inside the crossed range take part in the uncross
+            indicativeStale_ = true;
+        }
+        // A level this message emptied and recreated keeps its stamp, so each
+        // price is recorded once, with its aggregate from before the message
+        if(!recordingLevelUpdates_ || level.updateStamp_ == levelUpdateStamp_){
+            return;
+        }
+        level.updateStamp_ = levelUpdateStamp_;
+        levelUpdates_.push_back(LevelUpdate{ S, price, level.totalQuantity_, level.orderCount_ });
+    }
+
+    // Swaps each recorded level's old aggregate for its current one and
+    // drops the levels that ended up where they started
+    void FinishLevelUpdates()
+    {
+        recordingLevelUpdates_ = false;
+        std::size_t kept = 0;
+        for(const LevelUpdate& before : levelUpdates_){
+            const PriceLevel* level = before.side_ == Side::Buy ? bids_.FindLevel(before.price_) : asks_.FindLevel(before.price_);
+            LevelUpdate after{ before.side_, before.price_, 0, 0 };
+            if(level){
+                after.quantity_ = level->totalQuantity_;
+                after.orderCount_ = level->orderCount_;
+            }
+            if(after.quantity_ != before.quantity_ || after.orderCount_ != before.orderCount_){
+                levelUpdates_[kept++] = after;
+            }
+        }
+        levelUpdates_.resize(kept);
+    }
+
+    // splitmix64's finaliser
+    static std::uint64_t MixDigest(std::uint64_t value)
+    {
+        value ^= value >> 30;
+        value *= 0xbf58476d1ce4e5b9ull;
+        value ^= value >> 27;
+        value *= 0x94d049bb133111ebull;
+        value ^= value >> 31;
+        return value;
+    }
+
+    static std::uint64_t DigestTerm(OrderId orderId, Side side, Price price, Quantity quantity, OrderId aheadId)
+    {
+        std::uint64_t identity = static_cast<std::uint64_t>(orderId) * 0x9e3779b97f4a7c15ull + static_cast<std::uint64_t>(aheadId);
+        std::uint64_t placement = std::uint64_t{ static_cast<std::uint32_t>(price) } << 32 | static_cast<std::uint32_t>(quantity);
+        return MixDigest(identity ^ placement * 0xd6e8feb86659fd93ull ^ (side == Side::Sell ? 0x5851f42d4c957f2dull : 0));
+    }
+
+    // What a level's first order counts as queued behind
+    OrderId DigestAheadId(OrderSlot ahead) const
+    {
+        return ahead == InvalidOrderSlot ? std::numeric_limits<OrderId>::min() : pool_.Hot(ahead).orderId_;
+    }
+
+    // Before slot is appended to level
+    template<Side S>
+    void DigestPushBack(Price price, const PriceLevel& level, OrderSlot slot)
+    {
+        const OrderPool::HotNode& hot = pool_.Hot(slot);
+        digest_ += DigestTerm(hot.orderId_, S, price, hot.remainingQuantity_, DigestAheadId(level.tail_));
+    }
+
+    // Before slot, open for quantity, leaves its level: its own term goes,
+    // and the order behind it now queues behind the one ahead of it
+    template<Side S>
+    void DigestUnlink(Price price, OrderSlot slot, Quantity quantity)
+    {
+        const OrderPool::HotNode& hot = pool_.Hot(slot);
+        OrderId aheadId = DigestAheadId(pool_.Cold(slot).prev_);
+        digest_ -= DigestTerm(hot.orderId_, S, price, quantity, aheadId);
+        if(hot.next_ != InvalidOrderSlot){
+            const OrderPool::HotNode& behind = pool_.Hot(hot.next_);
+            digest_ -= DigestTerm(behind.orderId_, S, price, behind.remainingQuantity_, hot.orderId_);
+            digest_ += DigestTerm(behind.orderId_, S, price, behind.remainingQuantity_, aheadId);
+        }
+    }
+
+    // Before slot's open quantity changes in place
+    template<Side S>
+    void DigestRequantity(Price price, OrderSlot slot, Quantity before, Quantity after)
+    {
+        OrderId orderId = pool_.Hot(slot).orderId_;
+        OrderId aheadId = DigestAheadId(pool_.Cold(slot).prev_);
+        digest_ -= DigestTerm(orderId, S, price, before, aheadId);
+        digest_ += DigestTerm(orderId, S, price, after, aheadId);
+    }
+
+    // A fill of quantity against slot, the head of its level
+    template<Side S>
+    void DigestFill(Price price, OrderSlot slot, Quantity quantity)
+    {
+        Quantity open = pool_.Hot(slot).remainingQuantity_;
+        if(quantity < open){
+            DigestRequantity<S>(price, slot, open, open - quantity);
+        }
+        else{
+            DigestUnlink<S>(price, slot, open);
+        }
+    }
+
+    // Creates the participant's entry, with the default limits, on first use
+    ParticipantState& GetParticipantState(ParticipantId participant)
+    {
+        auto found = participants_.find(participant);
+        if(found == participants_.end()){
+            ParticipantState state;
+            state.limits_ = defaultRiskLimits_;
+            found = participants_.emplace(participant, state).first;
+        }
+        return found->second;
+    }
+
+    // Null for an unowned order; an owned resting order's entry always exists
+    ParticipantState* FindParticipantState(ParticipantId participant)
+    {
+        return participant == NoParticipant ? nullptr : &participants_.find(participant)->second;
+    }
+
+    // The pre-trade stage: counts the message against the rate window, then
+    // checks the open orders and notional it would add. Additions of zero or
+    // less always pass, so a participant over a lowered limit can still
+    // shrink its orders.
+    bool PassesRiskLimits(ParticipantState& state, OrderId orderId, std::uint32_t addedOrders, std::int64_t addedNotional)
+    {
+        const RiskLimits& limits = state.limits_;
+        if(limits.maxMessages_){
+            if(now_ - state.windowStart_ >= limits.messageWindow_){
+                state.windowStart_ = now_;
+                state.windowMessages_ = 0;
+            }
+            if(state.windowMessages_ >= limits.maxMessages_){
+                sink_->OnOrderRejected(orderId, RejectReason::MessageRateLimit);
+                return false;
+            }
+            ++state.windowMessages_;
+        }
+        if(limits.maxOpenOrders_ && addedOrders && state.orderCount_ + addedOrders > limits.maxOpenOrders_){
+            sink_->OnOrderRejected(orderId, RejectReason::OpenOrderLimit);
+            return false;
+        }
+        if(limits.maxOpenNotional_ && addedNotional > 0 && state.openNotional_ + addedNotional > limits.maxOpenNotional_){
+            sink_->OnOrderRejected(orderId, RejectReason::NotionalLimit);
+            return false;
+        }
+        return true;
+    }
+
+    // Places an order at the back of its level and indexes it
+    template<Side S>
+    void InsertOrder(const Order& order, ParticipantState* owner)
+    {
+        OrderSlot slot = pool_.Allocate(order);
+        PriceLevel& level = Levels<S>().GetOrCreateLevel(order.GetPrice());
+        RecordLevelUpdate<S>(order.GetPrice(), level);
+        if(digestEnabled_){
+            DigestPushBack<S>(order.GetPrice(), level, slot);
+        }
+        pool_.PushBack(level, slot);
+        orders_.Insert(order.GetOrderId(), slot);
+        if(owner){
+            pool_.LinkParticipant(*owner, slot);
+            owner->openNotional_ += Notional(order.GetPrice(), order.GetRemainingQuantity());
+        }
+        if(order.GetOrderType() == OrderType::GoodTillTime){
+            expiries_.Schedule(pool_, slot, order.GetExpiry());
+        }
+        else if(order.GetOrderType() == OrderType::GoodForDay){
+            expiries_.ScheduleDay(pool_, slot);
+        }
+    }
+
+    // Returns a slot that is no longer in a level or the id index to the pool
+    void ReleaseSlot(OrderSlot slot)
+    {
+        ReleaseSlot(slot, FindParticipantState(pool_.Cold(slot).participant_));
+    }
+
+    void ReleaseSlot(OrderSlot slot, ParticipantState* owner)
+    {
+        if(owner){
+            owner->openNotional_ -= Notional(pool_.Cold(slot).price_, pool_.Hot(slot).remainingQuantity_);
+            pool_.UnlinkParticipant(*owner, slot);
+        }
+        if(pool_.Cold(slot).timerBucket_ != NoTimerBucket){
+            expiries_.Unschedule(pool_, slot);
+        }
+        pool_.Release(slot);
+    }
+
+    // An order the wheel has just taken off its schedule, through the cancel path
+    void ExpireSlot(OrderSlot slot)
+    {
+        orders_.Erase(pool_.Hot(slot).orderId_);
+        if(pool_.Cold(slot).side_ == Side::Buy){
+            CancelSlot<Side::Buy>(slot);
+        }
+        else{
+            CancelSlot<Side::Sell>(slot);
+        }
+    }
+
+    void CancelEntry(OrderIndex::Entry* entry)
+    {
+        if(pool_.Cold(entry->slot_).side_ == Side::Buy){
+            CancelEntry<Side::Buy>(entry);
+        }
+        else{
+            CancelEntry<Side::Sell>(entry);
+        }
+    }
+
+    template<Side S>
+    void CancelEntry(OrderIndex::Entry* entry)
+    {
+        OrderSlot slot = entry->slot_;
+        orders_.Erase(entry); // Remove from the order id index
+        CancelSlot<S>(slot);
+    }
+
+    // Cancels a resting order that is already out of the id index
+    template<Side S>
+    void CancelSlot(OrderSlot slot)
+    {
+        OrderId orderId = pool_.Hot(slot).orderId_;
+        Price price = pool_.Cold(slot).price_;
+
+        auto& levels = Levels<S>();
+        PriceLevel& level = *levels.FindLevel(price);
+        RecordLevelUpdate<S>(price, level);
+        if(digestEnabled_){
+            DigestUnlink<S>(price, slot, pool_.Hot(slot).remainingQuantity_);
+        }
+        pool_.Unlink(level, slot); // Remove from price level queue
+        if(level.IsEmpty()){ // If price level becomes empty, remove it from the side
+            levels.EraseLevel(price);
+        }
+        ReleaseSlot(slot);
+        sink_->OnOrderCancelled(orderId);
+    }
+
+    // Drops whole levels instead of unlinking order by order; only the id
+    // index and the participant chains are still touched per order
+    template<Side S>
+    std::size_t CancelRange(Price minPrice, Price maxPrice)
+    {
+        std::size_t cancelled = 0;
+        Levels<S>().EraseLevels(minPrice, maxPrice, [&](Price price, PriceLevel& level){
+            RecordLevelUpdate<S>(price, level);
+            OrderSlot slot = level.head_;
+            while(slot != InvalidOrderSlot){
+                OrderSlot next = pool_.Hot(slot).next_;
+                OrderId orderId = pool_.Hot(slot).orderId_;
+                if(digestEnabled_){
+                    digest_ -= DigestTerm(orderId, S, price, pool_.Hot(slot).remainingQuantity_, DigestAheadId(pool_.Cold(slot).prev_));
+                }
+                orders_.Erase(orderId);
+                ReleaseSlot(slot);
+                sink_->OnOrderCancelled(orderId);
+                ++cancelled;
+                slot = next;
+            }
+        });
+        return cancelled;
+    }
+
+    // True if the opposite levels crossing price hold at least quantity,
+    // read from the level aggregates without touching any order
+    template<Side S>
+    bool HasLiquidity(Price price, Quantity quantity) const
+    {
+        return Levels<SideTraits<S>::Opposite>().GetQuantityThrough(price, quantity) >= quantity;
+    }
+
+    // The matching path: the incoming order walks the opposite side best
+    // level first, filling against resting orders until it is filled or
+    // (when priceLimited) the next level no longer crosses its price. The
+    // incoming order is not in the book while it sweeps; the caller rests
+    // whatever remains. Every fill trades at the resting level's price.
+    template<Side S, typename OnTrade>
+    void SweepOpposite(Order& incoming, bool priceLimited, OnTrade& onTrade)
+    {
+        auto& opposite = Levels<SideTraits<S>::Opposite>();
+        while(!incoming.IsFilled() && !opposite.IsEmpty())
+        {
+            Price levelPrice = opposite.GetBestPrice();
+            if(priceLimited && !SideTraits<S>::Crosses(incoming.GetPrice(), levelPrice)){
+                break;
+            }
+            PriceLevel& level = opposite.GetBestLevel();
+            RecordLevelUpdate<SideTraits<S>::Opposite>(levelPrice, level);
+            while(!incoming.IsFilled() && !level.IsEmpty())
+            {
+                OrderSlot slot = level.head_;
+                OrderPool::HotNode& resting = pool_.Hot(slot);
+                Quantity quantity = std::min(incoming.GetRemainingQuantity(), resting.remainingQuantity_);
+                if(digestEnabled_){
+                    DigestFill<SideTraits<S>::Opposite>(levelPrice, slot, quantity);
+                }
+                incoming.Fill(quantity);
+                resting.remainingQuantity_ -= quantity;
+                level.totalQuantity_ -= quantity;
+                ParticipantState* owner = FindParticipantState(pool_.Cold(slot).participant_);
+                if(owner){
+                    owner->openNotional_ -= Notional(levelPrice, quantity);
+                }
+
+                const Trade trade{ resting.orderId_, incoming.GetOrderId(), levelPrice, quantity, S, ++tradeSequence_ };
+                sink_->OnTrade(trade);
+                onTrade(trade);
+
+                if(resting.remainingQuantity_ == 0){
+                    pool_.Unlink(level, slot);
+                    orders_.Erase(resting.orderId_);
+                    ReleaseSlot(slot, owner);
+                }
+            }
+            if(level.IsEmpty()){
+                opposite.EraseLevel(levelPrice);
+            }
+        }
+    }
+
+    // Ranks two uncross prices: more volume, then less surplus, then the
+    // side with the surplus pushing the price its way, then nearer the
+    // reference price. Candidates arrive in ascending price order, so an
+    // exact tie keeps the lower price.
+    bool IsBetterUncross(const IndicativeUncross& candidate, const IndicativeUncross& best) const
+    {
+        if(candidate.volume_ != best.volume_){
+            return candidate.volume_ > best.volume_;
+        }
+        auto magnitude = [](std::int64_t value){ return value < 0 ? -value : value; };
+        if(magnitude(candidate.surplus_) != magnitude(best.surplus_)){
+            return magnitude(candidate.surplus_) < magnitude(best.surplus_);
+        }
+        if(candidate.surplus_ > 0 && best.surplus_ > 0){
+            return candidate.price_ > best.price_;
+        }
+        if(candidate.surplus_ < 0 && best.surplus_ < 0){
+            return candidate.price_ < best.price_;
+        }
+        return magnitude(std::int64_t{ candidate.price_ } - auctionReferencePrice_)
+            < magnitude(std::int64_t{ best.price_ } - auctionReferencePrice_);
+    }
+
+    // Evaluates every level price between the best ask and the best bid
+    // from the level aggregates alone. Bids below the best ask and asks
+    // above the best bid cannot trade at any of them, so nothing outside
+    // that range is visited.
+    IndicativeUncross ComputeIndicativeUncross() const
+    {
+        IndicativeUncross best{ auctionReferencePrice_, 0, 0 };
+        if(bids_.IsEmpty() || asks_.IsEmpty() || bids_.GetBestPrice() < asks_.GetBestPrice()){
+            return best;
+        }
+        Price low = asks_.GetBestPrice();
+        Price high = bids_.GetBestPrice();
+        auctionBids_.clear();
+        auctionAsks_.clear();
+        std::int64_t bidTotal = 0;
+        bids_.ForEachLevelWhile([&](Price price, const PriceLevel& level){
+            if(price < low){
+                return false;
+            }
+            auctionBids_.push_back(LevelInfo{ price, level.totalQuantity_, level.orderCount_ });
+            bidTotal += level.totalQuantity_;
+            return true;
+        });
+        asks_.ForEachLevelWhile([&](Price price, const PriceLevel& level){
+            if(price > high){
+                return false;
+            }
+            auctionAsks_.push_back(LevelInfo{ price, level.totalQuantity_, level.orderCount_ });
+            return true;
+        });
+        std::reverse(auctionBids_.begin(), auctionBids_.end());
+
+        // At each price, buying is every bid at or above it and selling
+        // every ask at or below it
+        std::int64_t bidsBelow = 0;
+        std::int64_t asksAtOrBelow = 0;
+        std::size_t bid = 0;
+        std::size_t ask = 0;
+        while(bid < auctionBids_.size() || ask < auctionAsks_.size()){
+            Price price = ask == auctionAsks_.size() ? auctionBids_[bid].price_
+                        : bid == auctionBids_.size() ? auctionAsks_[ask].price_
+                        : std::min(auctionBids_[bid].price_, auctionAsks_[ask].price_);
+            if(ask < auctionAsks_.size() && auctionAsks_[ask].price_ == price){
+                asksAtOrBelow += auctionAsks_[ask++].quantity_;
+            }
+            std::int64_t bidsAtOrAbove = bidTotal - bidsBelow;
+            if(bid < auctionBids_.size() && auctionBids_[bid].price_ == price){
+                bidsBelow += auctionBids_[bid++].quantity_;
+            }
+            IndicativeUncross candidate{ price, std::min(bidsAtOrAbove, asksAtOrBelow), bidsAtOrAbove - asksAtOrBelow };
+            if(IsBetterUncross(candidate, best)){
+                best = candidate;
+            }
+        }
+        return best;
+    }
+
+    // Trades the best bids against the best asks, both in price-time
+    // order, until uncross.volume_ has executed, all at uncross.price_.
+    // Maximising volume leaves the book uncrossed afterwards.
+    template<typename OnTrade>
+    void Uncross(const IndicativeUncross& uncross, OnTrade& onTrade)
+    {
+        Side aggressor = uncross.surplus_ < 0 ? Side::Sell : Side::Buy;
+        std::int64_t remaining = uncross.volume_;
+        while(remaining > 0)
+        {
+            Price bidPrice = bids_.GetBestPrice();
+            Price askPrice = asks_.GetBestPrice();
+            PriceLevel& bidLevel = bids_.GetBestLevel();
+            PriceLevel& askLevel = asks_.GetBestLevel();
+            RecordLevelUpdate<Side::Buy>(bidPrice, bidLevel);
+            RecordLevelUpdate<Side::Sell>(askPrice, askLevel);
+            OrderSlot bidSlot = bidLevel.head_;
+            OrderSlot askSlot = askLevel.head_;
+            OrderPool::HotNode& bid = pool_.Hot(bidSlot);
+            OrderPool::HotNode& ask = pool_.Hot(askSlot);
+            Quantity quantity = static_cast<Quantity>(std::min<std::int64_t>(std::min(bid.remainingQuantity_, ask.remainingQuantity_), remaining));
+            if(digestEnabled_){
+                DigestFill<Side::Buy>(bidPrice, bidSlot, quantity);
+                DigestFill<Side::Sell>(askPrice, askSlot, quantity);
+            }
+            bid.remainingQuantity_ -= quantity;
+            ask.remainingQuantity_ -= quantity;
+            bidLevel.totalQuantity_ -= quantity;
+            askLevel.totalQuantity_ -= quantity;
+            remaining -= quantity;
+            ParticipantState* bidOwner = FindParticipantState(pool_.Cold(bidSlot).participant_);
+            ParticipantState* askOwner = FindParticipantState(pool_.Cold(askSlot).participant_);
+            if(bidOwner){
+                bidOwner->openNotional_ -= Notional(bidPrice, quantity);
+            }
+            if(askOwner){
+                askOwner->openNotional_ -= Notional(askPrice, quantity);
+            }
+
+            const Trade trade{ aggressor == Side::Buy ? ask.orderId_ : bid.orderId_, aggressor == Side::Buy ? bid.orderId_ : ask.orderId_,
+                               uncross.price_, quantity, aggressor, ++tradeSequence_ };
+            sink_->OnTrade(trade);
+            onTrade(trade);
+
+            if(bid.remainingQuantity_ == 0){
+                pool_.Unlink(bidLevel, bidSlot);
+                orders_.Erase(bid.orderId_);
+                ReleaseSlot(bidSlot, bidOwner);
+                if(bidLevel.IsEmpty()){
+                    bids_.EraseLevel(bidPrice);
+                }
+            }
+            if(ask.remainingQuantity_ == 0){
+                pool_.Unlink(askLevel, askSlot);
+                orders_.Erase(ask.orderId_);
+                ReleaseSlot(askSlot, askOwner);
+                if(askLevel.IsEmpty()){
+                    asks_.EraseLevel(askPrice);
+                }
+            }
+        }
+    }
+
+    // The immediate-or-cancel family never rests, so it adds no open orders
+    static bool CanRest(OrderType orderType)
+    {
+        return orderType == OrderType::GoodTillCancel || orderType == OrderType::GoodForDay || orderType == OrderType::GoodTillTime
+            || orderType == OrderType::PostOnly;
+    }
+
+    // replacesOrder is set for a modify's replacement, which was checked as
+    // a whole before the original was cancelled and keeps its place in an
+    // auction even as a PostOnly
+    template<Side S, typename OnTrade>
+    void AddOrder(const Order& order, bool replacesOrder, OnTrade& onTrade)
+    {
+        ORDERBOOK_PROBE_TIMER(timer, Probe::AddOrder);
+        if(orders_.Find(order.GetOrderId()))
+        {
+            // Order with this ID already exists
+            sink_->OnOrderRejected(order.GetOrderId(), RejectReason::DuplicateOrderId);
+            return;
+        }
+        // Before the risk stage, so an empty order is never counted or rested
+        if(order.GetRemainingQuantity() <= 0){
+            sink_->OnOrderRejected(order.GetOrderId(), RejectReason::InvalidQuantity);
+            return;
+        }
+
+        if(auctionPhase_ && !replacesOrder && (!CanRest(order.GetOrderType()) || order.GetOrderType() == OrderType::PostOnly)){
+            sink_->OnOrderRejected(order.GetOrderId(), RejectReason::AuctionInProgress);
+            return;
+        }
+
+        // A replacement keeps the original's expiry even once it has passed;
+        // the wheel takes it out at the next AdvanceTime
+        if(!replacesOrder && order.GetOrderType() == OrderType::GoodTillTime && order.GetExpiry() <= now_){
+            sink_->OnOrderRejected(order.GetOrderId(), RejectReason::AlreadyExpired);
+            return;
+        }
+
+        ParticipantState* owner = nullptr;
+        if(order.GetParticipant() != NoParticipant){
+            owner = &GetParticipantState(order.GetParticipant());
+            bool rests = CanRest(order.GetOrderType());
+            if(!replacesOrder && !PassesRiskLimits(*owner, order.GetOrderId(), rests ? 1 : 0,
+                                                 rests ? Notional(order.GetPrice(), order.GetRemainingQuantity()) : 0)){
+                return;
+            }
+        }
+
+        if(auctionPhase_){
+            // Nothing trades until the uncross
+            ORDERBOOK_PROBE_LAP(timer, Probe::DuplicateCheck);
+            sink_->OnOrderAdded(order);
+            InsertOrder<S>(order, owner);
+            ORDERBOOK_PROBE_LAP(timer, Probe::LevelInsert);
+            return;
+        }
+
+        // The book is never left crossed, so only an order that can trade on
+        // arrival needs a matching pass; passive orders skip it entirely.
+        bool marketable = CanMatch<S>(order.GetPrice());
+        bool priceLimited = true;
+        bool restsRemainder = true;
+
+        switch(order.GetOrderType())
+        {
+        case OrderType::FillandKill:
+            // FillAndKill orders are rejected if they cannot match immediately
+            if(!marketable){
+                sink_->OnOrderRejected(order.GetOrderId(), RejectReason::NoImmediateMatch);
+                return;
+            }
+            restsRemainder = false;
+            break;
+        case OrderType::Market:
+            if(Levels<SideTraits<S>::Opposite>().IsEmpty()){
+                sink_->OnOrderRejected(order.GetOrderId(), RejectReason::NoLiquidity);
+                return;
+            }
+            marketable = true;
+            priceLimited = false;
+            restsRemainder = false;
+            break;
+        case OrderType::FillOrKill:
+            if(!marketable || !HasLiquidity<S>(order.GetPrice(), order.GetRemainingQuantity())){
+                sink_->OnOrderRejected(order.GetOrderId(), RejectReason::InsufficientLiquidity);
+                return;
+            }
+            restsRemainder = false;
+            break;
+        case OrderType::PostOnly:
+            if(marketable){
+                sink_->OnOrderRejected(order.GetOrderId(), RejectReason::WouldCross);
+                return;
+            }
+            break;
+        case OrderType::GoodTillCancel:
+        case OrderType::GoodForDay:
+        case OrderType::GoodTillTime:
+            break;
+        }
+
+        ORDERBOOK_PROBE_LAP(timer, Probe::DuplicateCheck);
+        sink_->OnOrderAdded(order);
+
+        if(!marketable){
+            InsertOrder<S>(order, owner);
+            ORDERBOOK_PROBE_LAP(timer, Probe::LevelInsert);
+            return;
+        }
+
+        // Only the remainder, if any, ever reaches the book
+        Order incoming{ order };
+        SweepOpposite<S>(incoming, priceLimited, onTrade);
+        ORDERBOOK_PROBE_LAP(timer, Probe::Matching);
+        if(incoming.IsFilled()){
+            return;
+        }
+        if(restsRemainder){
+            InsertOrder<S>(incoming, owner);
+            ORDERBOOK_PROBE_LAP(timer, Probe::LevelInsert);
+        }
+        else{
+            // Immediate-or-cancel family: the unfilled remainder is killed
+            sink_->OnOrderCancelled(order.GetOrderId());
+        }
+    }
+
+    template<Side S, typename OnTrade>
+    void ModifyEntry(OrderIndex::Entry* entry, const OrderModify& orderModify, OnTrade& onTrade)
+    {
+        OrderSlot slot = entry->slot_;
+        Order existingOrder = pool_.GetOrder(slot);
+        OrderType originalOrderType = existingOrder.GetOrderType(); // Preserve original order type
+
+        // The replacement keeps the order count and swaps one open notional for another
+        ParticipantState* owner = FindParticipantState(existingOrder.GetParticipant());
+        std::int64_t releasedNotional = Notional(existingOrder.GetPrice(), existingOrder.GetRemainingQuantity());
+        if(owner && !PassesRiskLimits(*owner, orderModify.GetOrderId(), 0,
+                                      Notional(orderModify.GetPrice(), orderModify.GetQuantity()) - releasedNotional)){
+            return;
+        }
+
+        sink_->OnOrderModified(existingOrder, orderModify);
+
+        // Shrinking an order at the same price keeps its place in the queue
+        if(orderModify.GetSide() == S
+            && orderModify.GetPrice() == existingOrder.GetPrice()
+            && orderModify.GetQuantity() > 0
+            && orderModify.GetQuantity() <= existingOrder.GetRemainingQuantity())
+        {
+            if(owner){
+                owner->openNotional_ -= releasedNotional - Notional(orderModify.GetPrice(), orderModify.GetQuantity());
+            }
+            if(digestEnabled_){
+                DigestRequantity<S>(existingOrder.GetPrice(), slot, existingOrder.GetRemainingQuantity(), orderModify.GetQuantity());
+            }
+            PriceLevel& level = *Levels<S>().FindLevel(existingOrder.GetPrice());
+            RecordLevelUpdate<S>(existingOrder.GetPrice(), level);
+            level.totalQuantity_ -= existingOrder.GetRemainingQuantity() - orderModify.GetQuantity();
+            existingOrder.ReduceQuantity(orderModify.GetQuantity());
+            pool_.Hot(slot).remainingQuantity_ = existingOrder.GetRemainingQuantity();
+            pool_.Cold(slot).initialQuantity_ = existingOrder.GetInitialQuantity();
+            return;
+        }
+
+        CancelEntry<S>(entry); // Cancel existing order
+        // Add a new order with the modified details, retaining the original order type and expiry
+        Order replacement = orderModify.ToOrder(originalOrderType, existingOrder.GetParticipant(), existingOrder.GetExpiry());
+        if(replacement.GetSide() == Side::Buy){
+            AddOrder<Side::Buy>(replacement, true, onTrade);
+        }
+        else{
+            AddOrder<Side::Sell>(replacement, true, onTrade);
+        }
+    }
+
+public:
+    Orderbook()
+        : Orderbook(OrderbookConfig{})
+    {}
+
+    explicit Orderbook(const OrderbookConfig& config)
+        : pool_{ config.orderCapacity_ }
+        , bids_{ config.referencePrice_, config.ladderTicks_ }
+        , asks_{ config.referencePrice_, config.ladderTicks_ }
+        , orders_{ config.orderIndexMode_, config.orderCapacity_, config.baseOrderId_ }
+        , defaultRiskLimits_{ config.riskLimits_ }
+        , expiries_{ config.expiryTick_ }
+        , levelUpdatesEnabled_{ config.levelUpdates_ }
+        , digestEnabled_{ config.digest_ }
+    {}
+
+    // Events go to sink until it is replaced; nullptr restores the no-op sink.
+    // The sink must outlive its use by the book.
+    void SetEventSink(OrderbookEventSink* sink)
+    {
+        sink_ = sink ? sink : &NullEventSink::Instance();
+    }
+
+    Trades AddOrder(OrderPointer order)
+    {
+        return AddOrder(*order);
+    }
+
+    Trades AddOrder(const Order& order)
+    {
+        Trades trades;
+        AddOrder(order, trades);
+        return trades;
+    }
+
+    // Appends fills to a caller-owned buffer. Reusing (clearing) the same
+    // buffer across calls keeps the steady-state path free of allocation.
+    void AddOrder(const Order& order, Trades& trades)
+    {
+        AddOrder(order, [&trades](const Trade& trade){ trades.push_back(trade); });
+    }
+
+    // Reports each fill as onTrade(const Trade&) as soon as it happens
+    template<typename OnTrade>
+    void AddOrder(const Order& order, OnTrade&& onTrade)
+    {
+        LevelUpdateScope levelUpdateScope{ *this };
+        if(order.GetSide() == Side::Buy){
+            AddOrder<Side::Buy>(order, false, onTrade);
+        }
+        else{ // Side::Sell
+            AddOrder<Side::Sell>(order, false, onTrade);
+        }
+    }
+
+    void CancelOrder(OrderId orderId)
+    {
+        ORDERBOOK_PROBE_TIMER(timer, Probe::CancelOrder);
+        LevelUpdateScope levelUpdateScope{ *this };
+        OrderIndex::Entry* entry = orders_.Find(orderId);
+        if(!entry){
+            sink_->OnOrderRejected(orderId, RejectReason::CancelUnknownOrder);
+            return;
+        }
+        CancelEntry(entry);
+    }
+
+    // Mass cancels. Each reports OnOrderCancelled for every order it removes
+    // and returns how many it removed.
+    std::size_t CancelAll(Side side)
+    {
+        return CancelRange(side, std::numeric_limits<Price>::min(), std::numeric_limits<Price>::max());
+    }
+
+    // Every order on side priced in [minPrice, maxPrice]
+    std::size_t CancelRange(Side side, Price minPrice, Price maxPrice)
+    {
+        LevelUpdateScope levelUpdateScope{ *this };
+        if(side == Side::Buy){
+            return CancelRange<Side::Buy>(minPrice, maxPrice);
+        }
+        return CancelRange<Side::Sell>(minPrice, maxPrice);
+    }
+
+    // Every order of participant on both sides, e.g. when its session drops.
+    // Cancels go out in order id order rather than chain order, so a book
+    // restored from a snapshot reports them in the same order as the live one.
+    std::size_t CancelParticipantOrders(ParticipantId participant)
+    {
+        LevelUpdateScope levelUpdateScope{ *this };
+        auto orders = participants_.find(participant);
+        if(participant == NoParticipant || orders == participants_.end()){
+            return 0;
+        }
+        ParticipantState& owned = orders->second;
+        participantSlots_.clear();
+        for(OrderSlot slot = owned.head_; slot != InvalidOrderSlot; slot = pool_.Cold(slot).participantNext_){
+            participantSlots_.push_back(slot);
+        }
+        std::sort(participantSlots_.begin(), participantSlots_.end(), [this](OrderSlot left, OrderSlot right){
+            return pool_.Hot(left).orderId_ < pool_.Hot(right).orderId_;
+        });
+        for(OrderSlot slot : participantSlots_){
+            // Detached here, so releasing the slot skips the participant lookup
+            owned.openNotional_ -= Notional(pool_.Cold(slot).price_, pool_.Hot(slot).remainingQuantity_);
+            pool_.UnlinkParticipant(owned, slot);
+            pool_.Cold(slot).participant_ = NoParticipant;
+            orders_.Erase(pool_.Hot(slot).orderId_);
+            if(pool_.Cold(slot).side_ == Side::Buy){
+                CancelSlot<Side::Buy>(slot);
+            }
+            else{
+                CancelSlot<Side::Sell>(slot);
+            }
+        }
+        return participantSlots_.size();
+    }
+
+    // Resting orders participant currently has in the book
+    std::size_t GetParticipantOrderCount(ParticipantId participant) const
+    {
+        auto orders = participants_.find(participant);
+        return participant == NoParticipant || orders == participants_.end() ? 0 : orders->second.orderCount_;
+    }
+
+    // Price times open quantity over participant's resting orders
+    std::int64_t GetParticipantOpenNotional(ParticipantId participant) const
+    {
+        auto orders = participants_.find(participant);
+        return participant == NoParticipant || orders == participants_.end() ? 0 : orders->second.openNotional_;
+    }
+
+    // Replaces the pre-trade limits of participant, whose orders are
+    // checked against them from the next add or modify on. Resting orders
+    // over a tightened limit stay; only what the participant adds is held
+    // back. Orders without a participant are never limited. A journaled
+    // book should take new limits as OrderRequest::SetRiskLimits, so that
+    // replay sees them at the same point in the flow.
+    void SetRiskLimits(ParticipantId participant, const RiskLimits& limits)
+    {
+        if(participant == NoParticipant){
+            throw std::logic_error("Risk limits need a participant.");
+        }
+        GetParticipantState(participant).limits_ = limits;
+    }
+
+    // Book time drives the message rate windows and order expiry. It only
+    // moves forward; an earlier time than the current one is ignored. Every
+    // GoodTillTime order whose expiry has passed, with OrderbookConfig::
+    // expiryTick_ granularity, and every GoodForDay order once the session
+    // end has (see SetSessionEnd), is cancelled as if by CancelOrder,
+    // reported through OnOrderCancelled, and the count is returned; orders
+    // expire in time order, the GoodForDay ones together at the session end.
+    // Call it on the matching thread between messages, e.g. with each
+    // message's gateway time or from a timer; the work is proportional to
+    // what expires.
+    std::size_t AdvanceTime(Timestamp now)
+    {
+        LevelUpdateScope levelUpdateScope{ *this };
+        now_ = std::max(now_, now);
+        auto expire = [this](OrderSlot slot){ ExpireSlot(slot); };
+        std::size_t expired = 0;
+        if(sessionEnd_ && now_ >= sessionEnd_ && expiries_.DayCount() != 0){
+            expired += expiries_.Advance(pool_, sessionEnd_, expire);
+            expired += expiries_.ExpireDay(pool_, expire);
+        }
+        return expired + expiries_.Advance(pool_, now_, expire);
+    }
+
+    Timestamp GetTime() const { return now_; }
+
+    // From now on GoodForDay orders, resting ones included, expire through
+    // AdvanceTime once the book time reaches end (at the next advance if
+    // it already has); 0 leaves them to ExpireGoodForDayOrders. They all
+    // sit in one chain, so this is O(1). Send it as an OrderRequest on a
+    // journaled book, so recovery replays it in order with the rest.
+    void SetSessionEnd(Timestamp end)
+    {
+        sessionEnd_ = end;
+    }
+
+    Timestamp GetSessionEnd() const { return sessionEnd_; }
+
+    // Resting orders waiting on an expiry
+    std::size_t GetScheduledExpiryCount() const
+    {
+        return expiries_.Size() + (sessionEnd_ ? expiries_.DayCount() : 0);
+    }
+
+    // Opening or closing auction. Until EndAuction, GoodTillCancel,
+    // GoodForDay and GoodTillTime orders rest without matching and may
+    // leave the book crossed; the immediate-or-cancel family and PostOnly
+    // are rejected with AuctionInProgress. Cancels, modifies, expiry and
+    // risk limits work as usual. referencePrice breaks the last tie between
+    // uncross prices, e.g. the previous close. Snapshots keep the phase and
+    // reference price; as OrderRequests both phase changes are journaled
+    // like any other.
+    void BeginAuction(Price referencePrice)
+    {
+        if(auctionPhase_){
+            throw std::logic_error("An auction is already in progress.");
+        }
+        auctionPhase_ = true;
+        auctionReferencePrice_ = referencePrice;
+        indicativeStale_ = true;
+    }
+
+    bool IsInAuction() const { return auctionPhase_; }
+
+    // The referencePrice of the current or last auction
+    Price GetAuctionReferencePrice() const { return auctionReferencePrice_; }
+
+    // The price, volume and surplus the auction would uncross at now.
+    // Reading it after a message that did not touch the crossed range is
+    // a copy of the cached result.
+    IndicativeUncross GetIndicativeUncross() const
+    {
+        if(!auctionPhase_){
+            return ComputeIndicativeUncross();
+        }
+        if(indicativeStale_){
+            indicative_ = ComputeIndicativeUncross();
+            indicativeStale_ = false;
+        }
+        return indicative_;
+    }
+
+    Trades EndAuction()
+    {
+        Trades trades;
+        EndAuction(trades);
+        return trades;
+    }
+
+    void EndAuction(Trades& trades)
+    {
+        EndAuction([&trades](const Trade& trade){ trades.push_back(trade); });
+    }
+
+    // Uncrosses once at the indicative price, then returns to continuous
+    // matching. Bids at or above the price trade against asks at or below
+    // it, best price then time first, with the side holding the surplus
+    // (buy when balanced) reported as aggressor on every fill.
+    template<typename OnTrade>
+    void EndAuction(OnTrade&& onTrade)
+    {
+        if(!auctionPhase_){
+            throw std::logic_error("No auction is in progress.");
+        }
+        LevelUpdateScope levelUpdateScope{ *this };
+        IndicativeUncross uncross = GetIndicativeUncross();
+        auctionPhase_ = false;
+        Uncross(uncross, onTrade);
+    }
+
+    // End of session: cancels every resting GoodForDay order, walking only
+    // those orders. Journaled like SetSessionEnd when sent as an OrderRequest.
+    void ExpireGoodForDayOrders()
+    {
+        LevelUpdateScope levelUpdateScope{ *this };
+        expiries_.ExpireDay(pool_, [this](OrderSlot slot){ ExpireSlot(slot); });
+    }
+
+    Trades ModifyOrder(OrderModify orderModify)
+    {
+        Trades trades;
+        ModifyOrder(orderModify, trades);
+        return trades;
+    }
+
+    void ModifyOrder(OrderModify orderModify, Trades& trades)
+    {
+        ModifyOrder(orderModify, [&trades](const Trade& trade){ trades.push_back(trade); });
+    }
+
+    template<typename OnTrade>
+    void ModifyOrder(OrderModify orderModify, OnTrade&& onTrade)
+    {
+        ORDERBOOK_PROBE_TIMER(timer, Probe::ModifyOrder);
+        LevelUpdateScope levelUpdateScope{ *this };
+        OrderIndex::Entry* entry = orders_.Find(orderModify.GetOrderId());
+        if(!entry){
+            sink_->OnOrderRejected(orderModify.GetOrderId(), RejectReason::ModifyUnknownOrder);
+            return;
+        }
+        // The original stays as it was; cancelling is CancelOrder's job
+        if(orderModify.GetQuantity() <= 0){
+            sink_->OnOrderRejected(orderModify.GetOrderId(), RejectReason::InvalidQuantity);
+            return;
+        }
+
+        if(pool_.Cold(entry->slot_).side_ == Side::Buy){
+            ModifyEntry<Side::Buy>(entry, orderModify, onTrade);
+        }
+        else{ // Side::Sell
+            ModifyEntry<Side::Sell>(entry, orderModify, onTrade);
+        }
+    }
+
+    // Applies requests in order into one shared trades buffer. Each message
+    // still gets exact price-time results: a matching pass runs only for the
+    // orders that cross on arrival, and the id index probe for a request a
+    // few entries ahead is prefetched while the current one is applied.
+    void ApplyBatch(const OrderRequest* requests, std::size_t count, Trades& trades)
+    {
+        ApplyBatch(requests, count, [&trades](const Trade& trade){ trades.push_back(trade); });
+    }
+
+    // Same, reporting each fill as onTrade(const Trade&), e.g. into a TradeBuffer
+    template<typename OnTrade>
+    void ApplyBatch(const OrderRequest* requests, std::size_t count, OnTrade&& onTrade)
+    {
+        LevelUpdateScope levelUpdateScope{ *this };
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            if(i + BatchPrefetchDistance < count){
+                orders_.Prefetch(requests[i + BatchPrefetchDistance].orderId_);
+            }
+            const OrderRequest& request = requests[i];
+            switch(request.type_)
+            {
+            case RequestType::Add:
+                AddOrder(request.ToOrder(), onTrade);
+                break;
+            case RequestType::Cancel:
+                CancelOrder(request.orderId_);
+                break;
+            case RequestType::Modify:
+                ModifyOrder(request.ToOrderModify(), onTrade);
+                break;
+            case RequestType::CancelRange:
+                CancelRange(request.side_, request.price_, request.maxPrice_);
+                break;
+            case RequestType::CancelParticipant:
+                CancelParticipantOrders(request.participant_);
+                break;
+            case RequestType::SetRiskLimits:
+                if(request.participant_ != NoParticipant){
+                    SetRiskLimits(request.participant_, request.ToRiskLimits());
+                }
+                break;
+            // A phase change that does not apply is dropped, not thrown, so
+            // a batch or a journal replay never stops halfway
+            case RequestType::BeginAuction:
+                if(!auctionPhase_){
+                    BeginAuction(request.price_);
+                }
+                break;
+            case RequestType::EndAuction:
+                if(auctionPhase_){
+                    EndAuction(onTrade);
+                }
+                break;
+            case RequestType::AdvanceTime:
+                AdvanceTime(request.time_);
+                break;
+            case RequestType::SetSessionEnd:
+                SetSessionEnd(request.time_);
+                break;
+            case RequestType::ExpireGoodForDay:
+                ExpireGoodForDayOrders();
+                break;
+            }
+        }
+    }
+
+    Trades ApplyBatch(const OrderRequests& requests)
+    {
+        Trades trades;
+        ApplyBatch(requests.data(), requests.size(), trades);
+        return trades;
+    }
+
+    void AddOrders(const Order* orders, std::size_t count, Trades& trades)
+    {
+        LevelUpdateScope levelUpdateScope{ *this };
+        auto onTrade = [&trades](const Trade& trade){ trades.push_back(trade); };
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            if(i + BatchPrefetchDistance < count){
+                orders_.Prefetch(orders[i + BatchPrefetchDistance].GetOrderId());
+            }
+            AddOrder(orders[i], onTrade);
+        }
+    }
+
+    Trades AddOrders(const std::vector<Order>& orders)
+    {
+        Trades trades;
+        AddOrders(orders.data(), orders.size(), trades);
+        return trades;
+    }
+
+    std::size_t Size() const { return orders_.Size();}
+
+    // With OrderbookConfig::levelUpdates_ set: every level whose aggregate
+    // the last AddOrder, CancelOrder, ModifyOrder, ApplyBatch, AddOrders,
+    // mass cancel, AdvanceTime or ExpireGoodForDayOrders call changed, each at most once, in the order
+    // they were first touched. Batches coalesce across all their requests.
+    // Valid until the next such call; always empty without the flag.
+    const LevelUpdates& GetLevelUpdates() const { return levelUpdates_; }
+
+    // Sequence number of the last trade, 0 before the first one
+    std::uint64_t GetTradeSequence() const { return tradeSequence_; }
+
+    // For rebuilding a book from a snapshot: the next trade is sequence + 1
+    void RestoreTradeSequence(std::uint64_t sequence) { tradeSequence_ = sequence; }
+
+    // Visits every participant the book has seen as
+    // f(ParticipantId, const ParticipantState&), in no particular order
+    template<typename F>
+    void ForEachParticipant(F&& f) const
+    {
+        for(const auto& participant : participants_){
+            f(participant.first, participant.second);
+        }
+    }
+
+    // For rebuilding a book from a snapshot: sets participant's limits and
+    // message rate window as ForEachParticipant reported them. Its order
+    // count and notional follow from the orders RestoreOrder brings back.
+    void RestoreParticipant(ParticipantId participant, const RiskLimits& limits, Timestamp windowStart, std::uint32_t windowMessages)
+    {
+        if(participant == NoParticipant){
+            throw std::logic_error("Risk limits need a participant.");
+        }
+        ParticipantState& state = GetParticipantState(participant);
+        state.limits_ = limits;
+        state.windowStart_ = windowStart;
+        state.windowMessages_ = windowMessages;
+    }
+
+    // For rebuilding a book from a snapshot, before its orders: sets the
+    // book time and session end as AdvanceTime and SetSessionEnd left them,
+    // so restored expiries are scheduled relative to now, without firing
+    // anything. The book must be empty.
+    void RestoreClock(Timestamp now, Timestamp sessionEnd)
+    {
+        if(Size() != 0){
+            throw std::logic_error("The clock can only be restored into an empty book.");
+        }
+        expiries_.RestoreTime(now);
+        now_ = now;
+        sessionEnd_ = sessionEnd;
+    }
+
+    // 64-bit fingerprint of every resting order's id, side, price, open
+    // quantity and place in its queue, maintained in a few multiplies per
+    // change when OrderbookConfig::digest_ is set (always 0 otherwise).
+    // Books holding the same orders in the same queue order agree however
+    // they got there, a book restored from a snapshot included, so a
+    // primary and its standby can compare it after every message.
+    std::uint64_t GetDigest() const { return digest_; }
+
+    // The same fingerprint recomputed from the orders, for checking a
+    // replica from scratch; available whether or not the digest is kept
+    std::uint64_t ComputeDigest() const
+    {
+        std::uint64_t digest = 0;
+        OrderId aheadId = 0;
+        Price aheadPrice = 0;
+        Side aheadSide = Side::Buy;
+        bool first = true;
+        ForEachOrder([&](const Order& order){
+            if(first || order.GetSide() != aheadSide || order.GetPrice() != aheadPrice){
+                aheadId = std::numeric_limits<OrderId>::min();
+            }
+            digest += DigestTerm(order.GetOrderId(), order.GetSide(), order.GetPrice(), order.GetRemainingQuantity(), aheadId);
+            aheadId = order.GetOrderId();
+            aheadPrice = order.GetPrice();
+            aheadSide = order.GetSide();
+            first = false;
+        });
+        return digest;
+    }
+
+    // Visits every resting order as f(const Order&): bids best to worst,
+    // then asks, each level in time priority
+    template<typename F>
+    void ForEachOrder(F&& f) const
+    {
+        auto visitLevel = [&](Price, const PriceLevel& level){
+            for(OrderSlot slot = level.head_; slot != InvalidOrderSlot; slot = pool_.Hot(slot).next_){
+                f(pool_.GetOrder(slot));
+            }
+        };
+        bids_.ForEachLevel(visitLevel);
+        asks_.ForEachLevel(visitLevel);
+    }
+
+    // Total quantity resting on side at price or better
+    std::int64_t GetQuantityThrough(Side side, Price price) const
+    {
+        return side == Side::Buy ? bids_.GetQuantityThrough(price) : asks_.GetQuantityThrough(price);
+    }
+
+    // Visits up to maxLevels levels of side best-first as f(const LevelInfo&),
+    // reading only the level aggregates
+    template<typename F>
+    void ForEachLevel(Side side, F&& f, std::size_t maxLevels = std::numeric_limits<std::size_t>::max()) const
+    {
+        auto visitLevel = [&f](Price price, const PriceLevel& level){
+            f(LevelInfo{ price, level.totalQuantity_, level.orderCount_ });
+        };
+        if(side == Side::Buy){
+            bids_.ForEachLevel(visitLevel, maxLevels);
+        }
+        else{ // Side::Sell
+            asks_.ForEachLevel(visitLevel, maxLevels);
+        }
+    }
+
+    // Appends a resting order to the back of its level with no matching and
+    // no events, for rebuilding a book from a snapshot taken in ForEachOrder
+    // order. The order keeps its filled quantity. Only during an auction
+    // may it cross the other side.
+    void RestoreOrder(const Order& order)
+    {
+        if(orders_.Find(order.GetOrderId())){
+            throw std::logic_error("Order (" + std::to_string(order.GetOrderId()) + ") is already in the book.");
+        }
+        if(order.IsFilled() || (!auctionPhase_ && CanMatch(order.GetSide(), order.GetPrice()))){
+            throw std::logic_error("Order (" + std::to_string(order.GetOrderId()) + ") cannot rest in the book.");
+        }
+        ParticipantState* owner = order.GetParticipant() == NoParticipant ? nullptr : &GetParticipantState(order.GetParticipant());
+        if(order.GetSide() == Side::Buy){
+            InsertOrder<Side::Buy>(order, owner);
+        }
+        else{ // Side::Sell
+            InsertOrder<Side::Sell>(order, owner);
+        }
+    }
+
+#if ORDERBOOK_INSTRUMENTATION
+    // Per-operation and per-phase latency histograms; safe to read from any thread
+    const OrderbookInstrumentation& GetInstrumentation() const { return instrumentation_; }
+    OrderbookInstrumentation& GetInstrumentation() { return instrumentation_; }
+#endif
+
+    OrderbookLevelInfos GetOrderInfos()const
+    {
+        return GetOrderInfos(std::numeric_limits<std::size_t>::max());
+    }
+
+    // Top-of-book depth: only the best maxLevels levels of each side are read
+    OrderbookLevelInfos GetOrderInfos(std::size_t maxLevels)const
+    {
+        LevelInfos bidInfos,askInfos;
+        bidInfos.reserve(std::min(maxLevels, bids_.GetLevelCount()));
+        askInfos.reserve(std::min(maxLevels, asks_.GetLevelCount()));
+
+        bids_.ForEachLevel([&](Price price,const PriceLevel& level){
+            bidInfos.push_back(LevelInfo{price,level.totalQuantity_,level.orderCount_});
+        }, maxLevels);
+        asks_.ForEachLevel([&](Price price,const PriceLevel& level){
+            askInfos.push_back(LevelInfo{price,level.totalQuantity_,level.orderCount_});
+        }, maxLevels);
+        return OrderbookLevelInfos{bidInfos,askInfos};
+    }
+};
+
+// --- Printing Helpers ---
+
+inline void PrintOrderbook(const Orderbook& orderbook, std::ostream& os = std::cout) {
+    OrderbookLevelInfos infos = orderbook.GetOrderInfos();
+    os << "\n--- Orderbook Snapshot (Size: " << orderbook.Size() << ") ---" << std::endl;
+
+    os << "Bids:" << std::endl;
+    if (infos.GetBids().empty()) {
+        os << "  (Empty)" << std::endl;
+    } else {
+        os << std::left << std::setw(10) << "Price" << "Quantity" << std::endl;
+        for (const auto& level : infos.GetBids()) {
+            os << std::left << std::setw(10) << level.price_ << level.quantity_ << std::endl;
+        }
+    }
+
+    os << "Asks:" << std::endl;
+    if (infos.GetAsks().empty()) {
+        os << "  (Empty)" << std::endl;
+    } else {
+        os << std::left << std::setw(10) << "Price" << "Quantity" << std::endl;
+        for (const auto& level : infos.GetAsks()) {
+            os << std::left << std::setw(10) << level.price_ << level.quantity_ << std::endl;
+        }
+    }
+    os << "--------------------------------------" << std::endl;
+}
+
+inline void PrintTrades(const Trades& trades, std::ostream& os = std::cout) {
+    if (trades.empty()) {
+        os << "No trades occurred." << std::endl;
+        return;
+    }
+    os << "\n--- Trades Executed ---" << std::endl;
+    os << std::left << std::setw(15) << "Bid Order ID"
+              << std::left << std::setw(10) << "Bid Price"
+              << std::left << std::setw(10) << "Ask Order ID"
+              << std::left << std::setw(10) << "Ask Price"
+              << std::left << "Quantity" << std::endl;
+    for (const auto& trade : trades) {
+        os << std::left << std::setw(15) << trade.GetBidTrade().orderId_
+                  << std::left << std::setw(10) << trade.GetBidTrade().price_
+                  << std::left << std::setw(10) << trade.GetAskTrade().orderId_
+                  << std::left << std::setw(10) << trade.GetAskTrade().price_
+                  << std::left << trade.GetBidTrade().quantity_ << std::endl;
+    }
+    os << "-------------------------" << std::endl;
+}
+
+// --- PrintingEventSink Class ---
+// Human-readable event log in the same format the book used to print
+// directly. Lines are not flushed individually.
+class PrintingEventSink : public OrderbookEventSink
+{
+public:
+    explicit PrintingEventSink(std::ostream& os = std::cout)
+        : os_{ os }
+    {}
+
+    void OnOrderAdded(const Order& order) override
+    {
+        os_ << "Added Order: ID " << order.GetOrderId()
+            << ", Side: " << (order.GetSide() == Side::Buy ? "Buy" : "Sell")
+            << ", Price: " << order.GetPrice()
+            << ", Quantity: " << order.GetInitialQuantity()
+            << ", Type: " << ToString(order.GetOrderType()) << '\n';
+    }
+
+    void OnOrderCancelled(OrderId orderId) override
+    {
+        os_ << "Cancelled Order: ID " << orderId << '\n';
+    }
+
+    void OnOrderModified(const Order& existingOrder, const OrderModify& orderModify) override
+    {
+        os_ << "Modifying Order ID " << orderModify.GetOrderId()
+            << " from Price: " << existingOrder.GetPrice() << ", Qty: " << existingOrder.GetRemainingQuantity()
+            << " to Price: " << orderModify.GetPrice() << ", Qty: " << orderModify.GetQuantity() << '\n';
+    }
+
+    void OnOrderRejected(OrderId orderId, RejectReason reason) override
+    {
+        switch(reason)
+        {
+        case RejectReason::DuplicateOrderId:
+            os_ << "Error: Order with ID " << orderId << " already exists. Cannot add duplicate." << '\n';
+            break;
+        case RejectReason::NoImmediateMatch:
+            os_ << "Order " << orderId << " (FAK) rejected: No immediate match available." << '\n';
+            break;
+        case RejectReason::NoLiquidity:
+            os_ << "Order " << orderId << " (MKT) rejected: No opposite liquidity." << '\n';
+            break;
+        case RejectReason::InsufficientLiquidity:
+            os_ << "Order " << orderId << " (FOK) rejected: Not enough liquidity to fill completely." << '\n';
+            break;
+        case RejectReason::WouldCross:
+            os_ << "Order " << orderId << " (POST) rejected: Would trade on arrival." << '\n';
+            break;
+        case RejectReason::CancelUnknownOrder:
+            os_ << "Error: Order with ID " << orderId << " not found for cancellation." << '\n';
+            break;
+        case RejectReason::ModifyUnknownOrder:
+            os_ << "Error: Order with ID " << orderId << " not found for modification." << '\n';
+            break;
+        case RejectReason::OpenOrderLimit:
+            os_ << "Order " << orderId << " rejected: Open order limit reached." << '\n';
+            break;
+        case RejectReason::NotionalLimit:
+            os_ << "Order " << orderId << " rejected: Open notional limit reached." << '\n';
+            break;
+        case RejectReason::MessageRateLimit:
+            os_ << "Order " << orderId << " rejected: Message rate limit reached." << '\n';
+            break;
+        case RejectReason::InvalidQuantity:
+            os_ << "Order " << orderId << " rejected: Quantity must be positive." << '\n';
+            break;
+        case RejectReason::AuctionInProgress:
+            os_ << "Order " << orderId << " rejected: Order type not accepted during the auction." << '\n';
+            break;
+        case RejectReason::AlreadyExpired:
+            os_ << "Order " << orderId << " (GTT) rejected: Expiry has already passed." << '\n';
+            break;
+        }
+    }
+
+    void OnTrade(const Trade& trade) override
+    {
+        os_ << "Trade: Bid ID " << trade.GetBidTrade().orderId_ << " @ " << trade.GetBidTrade().price_
+            << ", Ask ID " << trade.GetAskTrade().orderId_ << " @ " << trade.GetAskTrade().price_
+            << ", Quantity: " << trade.GetBidTrade().quantity_ << '\n';
+    }
+
+private:
+    std::ostream& os_;
+};
+
+// --- SpscQueue Class ---
+// Bounded lock-free single-producer/single-consumer ring. The producer and
+// consumer indices sit on separate cache lines, and each side keeps a cached
+// copy of the other's index so the shared line is only re-read when the
+// ring looks full (producer) or empty (consumer).
+template<typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(std::size_t capacity)
+    {
+        std::size_t size = 2;
+        while(size < capacity){
+            size *= 2;
+        }
+        buffer_.resize(size);
+        mask_ = size - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer side
+    bool TryPush(const T& value)
+    {
+        std::size_t head = head_.load(std::memory_order_relaxed);
+        if(head - cachedTail_ > mask_){
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if(head - cachedTail_ > mask_){
+                return false;
+            }
+        }
+        buffer_[head & mask_] = value;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: the element stays owned by the ring until Pop
+    T* Front()
+    {
+        std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if(tail == cachedHead_){
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if(tail == cachedHead_){
+                return nullptr;
+            }
+        }
+        return &buffer_[tail & mask_];
+    }
+
+    void Pop()
+    {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Safe to call from either side; exact only when the other side is idle
+    bool IsEmpty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    std::size_t Capacity() const { return mask_ + 1; }
+
+private:
+    static constexpr std::size_t CacheLineSize = 64;
+
+    std::vector<T> buffer_;
+    std::size_t mask_{ 0 };
+    alignas(CacheLineSize) std::atomic<std::size_t> head_{ 0 };
+    std::size_t cachedTail_{ 0 };
+    alignas(CacheLineSize) std::atomic<std::size_t> tail_{ 0 };
+    std::size_t cachedHead_{ 0 };
+};
+
+// --- AsyncEventSink Class ---
+// Copies each event into a ring buffer and returns; a background thread
+// drains the ring into a downstream sink (typically PrintingEventSink).
+// When the ring is full the matching thread waits for space rather than
+// dropping events.
+class AsyncEventSink : public OrderbookEventSink
+{
+public:
+    explicit AsyncEventSink(OrderbookEventSink& downstream, std::size_t capacity = 1 << 16)
+        : downstream_{ downstream }
+        , queue_{ capacity }
+        , worker_{ [this]{ Run(); } }
+    {}
+
+    ~AsyncEventSink() override
+    {
+        running_.store(false, std::memory_order_release);
+        worker_.join();
+    }
+
+    // Blocks until every event pushed so far has reached the downstream sink
+    void Flush()
+    {
+        while(!queue_.IsEmpty()){
+            std::this_thread::yield();
+        }
+    }
+
+    void OnOrderAdded(const Order& order) override
+    {
+        Push(MakeOrderEvent(EventType::Added, order));
+    }
+
+    void OnOrderCancelled(OrderId orderId) override
+    {
+        Event event{};
+        event.type_ = EventType::Cancelled;
+        event.orderId_ = orderId;
+        Push(event);
+    }
+
+    void OnOrderModified(const Order& existingOrder, const OrderModify& orderModify) override
+    {
+        Event event = MakeOrderEvent(EventType::Modified, existingOrder);
+        event.otherSide_ = orderModify.GetSide();
+        event.otherPrice_ = orderModify.GetPrice();
+        event.otherQuantity_ = orderModify.GetQuantity();
+        Push(event);
+    }
+
+    void OnOrderRejected(OrderId orderId, RejectReason reason) override
+    {
+        Event event{};
+        event.type_ = EventType::Rejected;
+        event.reason_ = reason;
+        event.orderId_ = orderId;
+        Push(event);
+    }
+
+    void OnTrade(const Trade& trade) override
+    {
+        Event event{};
+        event.type_ = EventType::Traded;
+        event.side_ = trade.GetAggressorSide();
+        event.orderId_ = trade.GetMakerOrderId();
+        event.price_ = trade.GetPrice();
+        event.quantity_ = trade.GetQuantity();
+        event.otherOrderId_ = trade.GetTakerOrderId();
+        event.sequence_ = trade.GetSequence();
+        Push(event);
+    }
+
+private:
+    enum class EventType : std::uint8_t
+    {
+        Added,
+        Cancelled,
+        Modified,
+        Rejected,
+        Traded
+    };
+
+    // Flat copy of any event. An added or modified order is carried whole,
+    // the resting order for a modify; other* fields carry the taker of a
+    // trade or the amend of a modify.
+    struct Event
+    {
+        EventType type_;
+        OrderType orderType_;
+        Side side_;
+        Side otherSide_;
+        RejectReason reason_;
+        ParticipantId participant_;
+        OrderId orderId_;
+        Price price_;
+        Quantity quantity_;         // Open quantity of an order
+        Quantity initialQuantity_;
+        Timestamp expiry_;
+        OrderId otherOrderId_;
+        Price otherPrice_;
+        Quantity otherQuantity_;
+        std::uint64_t sequence_;    // Trades only
+    };
+
+    static Event MakeOrderEvent(EventType type, const Order& order)
+    {
+        Event event{};
+        event.type_ = type;
+        event.orderType_ = order.GetOrderType();
+        event.side_ = order.GetSide();
+        event.participant_ = order.GetParticipant();
+        event.orderId_ = order.GetOrderId();
+        event.price_ = order.GetPrice();
+        event.quantity_ = order.GetRemainingQuantity();
+        event.initialQuantity_ = order.GetInitialQuantity();
+        event.expiry_ = order.GetExpiry();
+        return event;
+    }
+
+    static Order ToOrder(const Event& event)
+    {
+        Order order{ event.orderType_, event.orderId_, event.side_, event.price_, event.initialQuantity_,
+                     event.participant_, event.expiry_ };
+        order.Fill(event.initialQuantity_ - event.quantity_);
+        return order;
+    }
+
+    void Push(const Event& event)
+    {
+        while(!queue_.TryPush(event)){
+            std::this_thread::yield();
+        }
+    }
+
+    void Dispatch(const Event& event)
+    {
+        switch(event.type_)
+        {
+        case EventType::Added:
+            downstream_.OnOrderAdded(ToOrder(event));
+            break;
+        case EventType::Cancelled:
+            downstream_.OnOrderCancelled(event.orderId_);
+            break;
+        case EventType::Modified:
+            downstream_.OnOrderModified(ToOrder(event), OrderModify{ event.orderId_, event.otherSide_, event.otherPrice_, event.otherQuantity_ });
+            break;
+        case EventType::Rejected:
+            downstream_.OnOrderRejected(event.orderId_, event.reason_);
+            break;
+        case EventType::Traded:
+            downstream_.OnTrade(Trade{ event.orderId_, event.otherOrderId_, event.price_, event.quantity_,
+                                       event.side_, event.sequence_ });
+            break;
+        }
+    }
+
+    void Run()
+    {
+        while(true){
+            if(Event* event = queue_.Front()){
+                Dispatch(*event);
+                queue_.Pop();
+                continue;
+            }
+            if(!running_.load(std::memory_order_acquire)){
+                // The producer has stopped; drain whatever raced in and exit
+                if(queue_.IsEmpty()){
+                    return;
+                }
+                continue;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    OrderbookEventSink& downstream_;
+    SpscQueue<Event> queue_;
+    std::atomic<bool> running_{ true };
+    std::thread worker_;
+};
@@ -0,0 +1,454 @@
+#include "orderbook.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <random>
+
+// --- Allocation Counting ---
+// Every heap allocation in the process goes through these, so benchmarks
+// can report allocations per operation alongside time.
+namespace
+{
+    std::atomic<std::uint64_t> g_allocations{ 0 };
+}
+
+void* operator new(std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* memory = std::malloc(size ? size : 1)){
+        return memory;
+    }
+    throw std::bad_alloc{};
+}
+
+// GCC cannot see that the replaced new above is malloc-backed and warns
+// about the free below once it inlines both into library code.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+
+// --- BenchmarkState Class ---
+// Minimal Google-Benchmark-style harness. A benchmark body runs
+// `while(state.KeepRunningBatch(n)) { ...n operations... }`, and may bracket
+// untimed setup or teardown with PauseTiming/ResumeTiming. Allocations
+// made while paused are not counted.
+class BenchmarkState
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    BenchmarkState(const std::vector<std::int64_t>& args, std::uint64_t maxIterations)
+        : args_{ args }
+        , maxIterations_{ maxIterations }
+    {}
+
+    std::int64_t range(std::size_t index) const { return args_.at(index); }
+
+    bool KeepRunningBatch(std::uint64_t count)
+    {
+        if(!started_){
+            started_ = true;
+            ResumeTiming();
+        }
+        if(iterations_ >= maxIterations_){
+            PauseTiming();
+            return false;
+        }
+        iterations_ += count;
+        return true;
+    }
+
+    void PauseTiming()
+    {
+        elapsed_ += Clock::now() - start_;
+        allocations_ += g_allocations.load(std::memory_order_relaxed) - allocationsAtStart_;
+    }
+
+    void ResumeTiming()
+    {
+        allocationsAtStart_ = g_allocations.load(std::memory_order_relaxed);
+        start_ = Clock::now();
+    }
+
+    std::uint64_t GetIterations() const { return iterations_; }
+    std::uint64_t GetAllocations() const { return allocations_; }
+    double GetSeconds() const { return std::chrono::duration<double>(elapsed_).count(); }
+
+private:
+    std::vector<std::int64_t> args_;
+    std::uint64_t maxIterations_;
+    std::uint64_t iterations_{ 0 };
+    bool started_{ false };
+    Clock::time_point start_{};
+    Clock::duration elapsed_{ 0 };
+    std::uint64_t allocationsAtStart_{ 0 };
+    std::uint64_t allocations_{ 0 };
+};
+
+// --- Benchmark Registry ---
+using BenchmarkFunction = std::function<void(BenchmarkState&)>;
+
+struct Benchmark
+{
+    std::string name_;
+    BenchmarkFunction function_;
+    std::vector<std::string> argNames_;
+    std::vector<std::vector<std::int64_t>> argSets_;
+};
+
+std::vector<Benchmark>& Registry()
+{
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+std::string BenchmarkName(const Benchmark& benchmark, const std::vector<std::int64_t>& args)
+{
+    std::string name = benchmark.name_;
+    for(std::size_t i = 0; i < args.size(); ++i){
+        name += "/" + benchmark.argNames_[i] + ":" + std::to_string(args[i]);
+    }
+    return name;
+}
+
+void RunBenchmark(const Benchmark& benchmark, const std::vector<std::int64_t>& args, double minSeconds)
+{
+    std::string name = BenchmarkName(benchmark, args);
+
+    // Grow the iteration budget until one run lasts at least minSeconds
+    std::uint64_t maxIterations = 1;
+    while(true){
+        BenchmarkState state{ args, maxIterations };
+        benchmark.function_(state);
+        double seconds = state.GetSeconds();
+        if(seconds >= minSeconds || maxIterations >= (std::uint64_t{ 1 } << 34)){
+            double iterations = static_cast<double>(state.GetIterations());
+            std::cout << std::left << std::setw(72) << name
+                      << std::right << std::setw(12) << state.GetIterations()
+                      << std::setw(12) << std::fixed << std::setprecision(1) << seconds * 1e9 / iterations << " ns/op"
+                      << std::setw(10) << std::setprecision(2) << iterations / seconds / 1e6 << " Mop/s"
+                      << std::setw(10) << std::setprecision(3) << state.GetAllocations() / iterations << " allocs/op"
+                      << std::endl;
+            return;
+        }
+        double scale = seconds > 0 ? 1.4 * minSeconds / seconds : 10;
+        maxIterations = static_cast<std::uint64_t>(static_cast<double>(maxIterations) * std::min(std::max(scale, 2.0), 10.0));
+    }
+}
+
+// --- Book Fixtures ---
+enum class PriceDistribution
+{
+    Uniform,
+    PowerLaw    // Most orders close to the touch, a long thin tail behind it
+};
+
+enum class Backend
+{
+    Map,
+    Ladder
+};
+
+constexpr Price MidPrice = 10000;
+constexpr std::size_t ChunkSize = 1024;
+
+OrderbookConfig MakeConfig(Backend backend, std::int64_t levels, std::size_t capacity)
+{
+    OrderbookConfig config;
+    config.orderCapacity_ = capacity;
+    config.referencePrice_ = MidPrice;
+    config.ladderTicks_ = backend == Backend::Ladder ? static_cast<Price>(levels + 16) : 0;
+    config.orderIndexMode_ = OrderIndexMode::Direct;
+    config.baseOrderId_ = 1;
+    return config;
+}
+
+// Distance from the touch in ticks, 0 being the best level
+Price DrawDistance(std::mt19937_64& rng, PriceDistribution distribution, std::int64_t levels)
+{
+    std::uniform_real_distribution<double> unit{ 0.0, 1.0 };
+    double u = unit(rng);
+    if(distribution == PriceDistribution::PowerLaw){
+        u = u * u * u;
+    }
+    return static_cast<Price>(std::min<std::int64_t>(static_cast<std::int64_t>(u * static_cast<double>(levels)), levels - 1));
+}
+
+struct BookFixture
+{
+    // Book arguments are range(0..3): depth, levels, distribution, backend
+    explicit BookFixture(const BenchmarkState& state)
+        : orderbook{ MakeConfig(static_cast<Backend>(state.range(3)), state.range(1), static_cast<std::size_t>(state.range(0)) * 2 + ChunkSize * 2) }
+        , levels_{ state.range(1) }
+        , distribution_{ static_cast<PriceDistribution>(state.range(2)) }
+        , rng_{ 42 }
+    {
+        // Bids rest strictly below MidPrice and asks strictly above, so the
+        // fixture itself never trades.
+        for(std::int64_t i = 0; i < state.range(0); ++i){
+            AddResting(Side::Buy);
+            AddResting(Side::Sell);
+        }
+    }
+
+    Order MakeResting(Side side, Quantity quantity = 100)
+    {
+        Price distance = 1 + DrawDistance(rng_, distribution_, levels_);
+        Price price = side == Side::Buy ? MidPrice - distance : MidPrice + distance;
+        return Order{ OrderType::GoodTillCancel, nextOrderId++, side, price, quantity };
+    }
+
+    OrderId AddResting(Side side, Quantity quantity = 100)
+    {
+        Order order = MakeResting(side, quantity);
+        orderbook.AddOrder(order, trades);
+        return order.GetOrderId();
+    }
+
+    Orderbook orderbook;
+    Trades trades;
+    OrderId nextOrderId{ 1 };
+
+private:
+    std::int64_t levels_;
+    PriceDistribution distribution_;
+    std::mt19937_64 rng_;
+};
+
+// --- Benchmarks ---
+void BM_AddOrderResting(BenchmarkState& state)
+{
+    BookFixture fixture{ state };
+    std::vector<Order> orders;
+    orders.reserve(ChunkSize);
+    while(state.KeepRunningBatch(ChunkSize)){
+        state.PauseTiming();
+        orders.clear();
+        for(std::size_t i = 0; i < ChunkSize; ++i){
+            orders.push_back(fixture.MakeResting(i % 2 ? Side::Sell : Side::Buy));
+        }
+        state.ResumeTiming();
+
+        for(const Order& order : orders){
+            fixture.orderbook.AddOrder(order, fixture.trades);
+        }
+
+        state.PauseTiming();
+        for(const Order& order : orders){
+            fixture.orderbook.CancelOrder(order.GetOrderId());
+        }
+        state.ResumeTiming();
+    }
+}
+
+void BM_AddOrderCrossing(BenchmarkState& state)
+{
+    BookFixture fixture{ state };
+    std::vector<Order> orders;
+    orders.reserve(ChunkSize);
+    while(state.KeepRunningBatch(ChunkSize)){
+        state.PauseTiming();
+        orders.clear();
+        for(std::size_t i = 0; i < ChunkSize; ++i){
+            // Marketable at any depth, sized to take exactly one resting order
+            Side side = i % 2 ? Side::Sell : Side::Buy;
+            Price price = side == Side::Buy ? MidPrice + static_cast<Price>(state.range(1)) + 1
+                                            : MidPrice - static_cast<Price>(state.range(1)) - 1;
+            orders.push_back(Order{ OrderType::GoodTillCancel, fixture.nextOrderId++, side, price, 100 });
+        }
+        state.ResumeTiming();
+
+        for(const Order& order : orders){
+            fixture.trades.clear();
+            fixture.orderbook.AddOrder(order, fixture.trades);
+        }
+
+        state.PauseTiming();
+        // Put back the liquidity the chunk consumed
+        for(std::size_t i = 0; i < ChunkSize; ++i){
+            fixture.AddResting(i % 2 ? Side::Buy : Side::Sell);
+        }
+        state.ResumeTiming();
+    }
+}
+
+void BM_CancelOrder(BenchmarkState& state)
+{
+    BookFixture fixture{ state };
+    std::vector<OrderId> ids;
+    ids.reserve(ChunkSize);
+    while(state.KeepRunningBatch(ChunkSize)){
+        state.PauseTiming();
+        ids.clear();
+        for(std::size_t i = 0; i < ChunkSize; ++i){
+            ids.push_back(fixture.AddResting(i % 2 ? Side::Sell : Side::Buy));
+        }
+        // Cancel in a different order than arrival so cancels hit mid-queue
+        std::reverse(ids.begin(), ids.end());
+        state.ResumeTiming();
+
+        for(OrderId id : ids){
+            fixture.orderbook.CancelOrder(id);
+        }
+    }
+}
+
+// range(4): 0 = same-price quantity reduction, 1 = reprice by one tick
+void BM_ModifyOrder(BenchmarkState& state)
+{
+    BookFixture fixture{ state };
+    bool reprice = state.range(4) != 0;
+    std::vector<Order> orders;
+    orders.reserve(ChunkSize);
+    while(state.KeepRunningBatch(ChunkSize)){
+        state.PauseTiming();
+        orders.clear();
+        for(std::size_t i = 0; i < ChunkSize; ++i){
+            Order order = fixture.MakeResting(i % 2 ? Side::Sell : Side::Buy, 1000);
+            fixture.orderbook.AddOrder(order, fixture.trades);
+            orders.push_back(order);
+        }
+        state.ResumeTiming();
+
+        for(const Order& order : orders){
+            // Repricing moves each order one tick away from the touch, so it never crosses
+            Price price = order.GetPrice();
+            if(reprice){
+                price += order.GetSide() == Side::Buy ? -1 : 1;
+            }
+            fixture.orderbook.ModifyOrder(OrderModify{ order.GetOrderId(), order.GetSide(), price, reprice ? 1000 : 999 }, fixture.trades);
+        }
+
+        state.PauseTiming();
+        for(const Order& order : orders){
+            fixture.orderbook.CancelOrder(order.GetOrderId());
+        }
+        state.ResumeTiming();
+    }
+}
+
+// range(4): number of levels per side to snapshot, 0 = the whole book
+void BM_GetOrderInfos(BenchmarkState& state)
+{
+    BookFixture fixture{ state };
+    std::size_t maxLevels = state.range(4) ? static_cast<std::size_t>(state.range(4)) : std::numeric_limits<std::size_t>::max();
+    std::size_t levels = 0;
+    while(state.KeepRunningBatch(1)){
+        OrderbookLevelInfos infos = fixture.orderbook.GetOrderInfos(maxLevels);
+        levels += infos.GetBids().size();
+    }
+    if(levels == 0 && fixture.orderbook.Size() != 0){
+        std::cerr << "unexpected empty snapshot" << std::endl;
+    }
+}
+
+// Cumulative depth through the far edge of the populated band, as a FOK
+// liquidity check or a book-wide analytic would ask for it
+void BM_QuantityThrough(BenchmarkState& state)
+{
+    BookFixture fixture{ state };
+    Price farBid = MidPrice - static_cast<Price>(state.range(1));
+    Price farAsk = MidPrice + static_cast<Price>(state.range(1));
+    std::int64_t total = 0;
+    while(state.KeepRunningBatch(2)){
+        total += fixture.orderbook.GetQuantityThrough(Side::Buy, farBid);
+        total += fixture.orderbook.GetQuantityThrough(Side::Sell, farAsk);
+    }
+    if(total == 0 && fixture.orderbook.Size() != 0){
+        std::cerr << "unexpected empty depth" << std::endl;
+    }
+}
+
+void BM_FakReject(BenchmarkState& state)
+{
+    BookFixture fixture{ state };
+    std::vector<Order> orders;
+    orders.reserve(ChunkSize);
+    while(state.KeepRunningBatch(ChunkSize)){
+        state.PauseTiming();
+        orders.clear();
+        for(std::size_t i = 0; i < ChunkSize; ++i){
+            // Priced behind the opposite touch, so each one is rejected on arrival
+            Side side = i % 2 ? Side::Sell : Side::Buy;
+            orders.push_back(Order{ OrderType::FillandKill, fixture.nextOrderId++, side, MidPrice, 10 });
+        }
+        state.ResumeTiming();
+
+        for(const Order& order : orders){
+            fixture.orderbook.AddOrder(order, fixture.trades);
+        }
+    }
+}
+
+void RegisterBenchmarks()
+{
+    const std::vector<std::string> bookArgs{ "depth", "levels", "dist", "backend" };
+    std::vector<std::vector<std::int64_t>> books;
+    for(std::int64_t backend : { 0, 1 }){
+        for(std::int64_t distribution : { 0, 1 }){
+            books.push_back({ 1000, 10, distribution, backend });
+            books.push_back({ 100000, 100, distribution, backend });
+            books.push_back({ 100000, 2000, distribution, backend });
+        }
+    }
+    auto withExtra = [&books](std::initializer_list<std::int64_t> extras){
+        std::vector<std::vector<std::int64_t>> sets;
+        for(const auto& book : books){
+            for(std::int64_t extra : extras){
+                auto set = book;
+                set.push_back(extra);
+                sets.push_back(set);
+            }
+        }
+        return sets;
+    };
+    auto withMode = bookArgs;
+    withMode.push_back("mode");
+
+    Registry().push_back(Benchmark{ "BM_AddOrderResting", BM_AddOrderResting, bookArgs, books });
+    Registry().push_back(Benchmark{ "BM_AddOrderCrossing", BM_AddOrderCrossing, bookArgs, books });
+    Registry().push_back(Benchmark{ "BM_CancelOrder", BM_CancelOrder, bookArgs, books });
+    Registry().push_back(Benchmark{ "BM_ModifyOrder", BM_ModifyOrder, withMode, withExtra({ 0, 1 }) });
+    auto withTop = bookArgs;
+    withTop.push_back("top");
+    Registry().push_back(Benchmark{ "BM_GetOrderInfos", BM_GetOrderInfos, withTop, withExtra({ 0, 10 }) });
+    Registry().push_back(Benchmark{ "BM_QuantityThrough", BM_QuantityThrough, bookArgs, books });
+    Registry().push_back(Benchmark{ "BM_FakReject", BM_FakReject, bookArgs, books });
+}
+
+// --- Main ---
+// Usage: orderbook_bench [--filter=SUBSTRING] [--min-time=SECONDS]
+// dist: 0 = uniform, 1 = power-law; backend: 0 = map levels, 1 = price ladder
+int main(int argc, char** argv)
+{
+    std::string filter;
+    double minSeconds = 0.2;
+    for(int i = 1; i < argc; ++i){
+        if(std::strncmp(argv[i], "--filter=", 9) == 0){
+            filter = argv[i] + 9;
+        }
+        else if(std::strncmp(argv[i], "--min-time=", 11) == 0){
+            minSeconds = std::atof(argv[i] + 11);
+        }
+        else{
+            std::cerr << "Usage: " << argv[0] << " [--filter=SUBSTRING] [--min-time=SECONDS]" << std::endl;
+            return 1;
+        }
+    }
+
+    RegisterBenchmarks();
+    for(const Benchmark& benchmark : Registry()){
+        for(const auto& args : benchmark.argSets_){
+            if(filter.empty() || BenchmarkName(benchmark, args).find(filter) != std::string::npos){
+                RunBenchmark(benchmark, args, minSeconds);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "orderbook.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// --- DepthSnapshot Struct ---
+// A consistent top-N view of the book as a reader sees it. Reuse one
+// snapshot per reader so its vectors keep their capacity between reads.
+struct DepthSnapshot
+{
+    std::uint64_t version_{ 0 };         // Number of Publish calls it reflects
+    std::uint64_t tradeSequence_{ 0 };   // Orderbook::GetTradeSequence at publication
+    LevelInfos bids_;
+    LevelInfos asks_;
+};
+
+// --- DepthPublisher Class ---
+// Seqlock around the best depth levels of each side, so threads other than
+// the matching thread can read top of book without a lock. The single
+// writer (the thread that owns the book) calls Publish after each message;
+// any number of readers call Read or TryRead at any time. Writers never
+// wait for readers, and a reader that overlaps a Publish simply retries.
+//
+// Every published value is an atomic word (price and quantity share one,
+// order count has its own), so readers never race on plain memory even
+// while they see a torn view that the sequence check then discards.
+class DepthPublisher
+{
+public:
+    explicit DepthPublisher(std::size_t depth)
+        : depth_{ depth }
+        , words_{ new std::atomic<std::uint64_t>[HeaderWords + 4 * depth] }
+    {
+        for(std::size_t i = 0; i < HeaderWords + 4 * depth_; ++i){
+            words_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    DepthPublisher(const DepthPublisher&) = delete;
+    DepthPublisher& operator=(const DepthPublisher&) = delete;
+
+    std::size_t GetDepth() const { return depth_; }
+
+    // Writer side: copies the best GetDepth() levels of each side
+    void Publish(const Orderbook& orderbook)
+    {
+        std::uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::uint64_t bidCount = StoreLevels(orderbook, Side::Buy, BidWords());
+        std::uint64_t askCount = StoreLevels(orderbook, Side::Sell, AskWords());
+        words_[CountsWord].store(bidCount | askCount << 32, std::memory_order_relaxed);
+        words_[TradeSequenceWord].store(orderbook.GetTradeSequence(), std::memory_order_relaxed);
+
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Reader side: false if a Publish overlapped the read, leaving snapshot
+    // unspecified. At most maxLevels levels per side are copied.
+    bool TryRead(DepthSnapshot& snapshot, std::size_t maxLevels = std::numeric_limits<std::size_t>::max()) const
+    {
+        std::uint64_t sequence = sequence_.load(std::memory_order_acquire);
+        if(sequence & 1){
+            return false;
+        }
+        std::uint64_t counts = words_[CountsWord].load(std::memory_order_relaxed);
+        snapshot.tradeSequence_ = words_[TradeSequenceWord].load(std::memory_order_relaxed);
+        LoadLevels(BidWords(), std::min<std::uint64_t>(counts & 0xffffffff, maxLevels), snapshot.bids_);
+        LoadLevels(AskWords(), std::min<std::uint64_t>(counts >> 32, maxLevels), snapshot.asks_);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(sequence_.load(std::memory_order_relaxed) != sequence){
+            return false;
+        }
+        snapshot.version_ = sequence / 2;
+        return true;
+    }
+
+    // Reader side: retries until it gets a consistent view
+    void Read(DepthSnapshot& snapshot, std::size_t maxLevels = std::numeric_limits<std::size_t>::max()) const
+    {
+        while(!TryRead(snapshot, maxLevels)){
+        }
+    }
+
+private:
+    static constexpr std::size_t CacheLineSize = 64;
+    static constexpr std::size_t CountsWord = 0;          // Bid count | ask count << 32
+    static constexpr std::size_t TradeSequenceWord = 1;
+    static constexpr std::size_t HeaderWords = 2;
+
+    std::size_t BidWords() const { return HeaderWords; }
+    std::size_t AskWords() const { return HeaderWords + 2 * depth_; }
+
+    std::uint64_t StoreLevels(const Orderbook& orderbook, Side side, std::size_t first)
+    {
+        std::uint64_t count = 0;
+        orderbook.ForEachLevel(side, [&](const LevelInfo& level){
+            std::size_t word = first + 2 * count++;
+            words_[word].store(static_cast<std::uint64_t>(static_cast<std::uint32_t>(level.price_)) << 32
+                               | static_cast<std::uint32_t>(level.quantity_), std::memory_order_relaxed);
+            words_[word + 1].store(level.orderCount_, std::memory_order_relaxed);
+        }, depth_);
+        return count;
+    }
+
+    void LoadLevels(std::size_t first, std::uint64_t count, LevelInfos& levels) const
+    {
+        levels.clear();
+        for(std::size_t i = 0; i < count; ++i){
+            std::uint64_t priceAndQuantity = words_[first + 2 * i].load(std::memory_order_relaxed);
+            std::uint64_t orderCount = words_[first + 2 * i + 1].load(std::memory_order_relaxed);
+            levels.push_back(LevelInfo{ static_cast<Price>(static_cast<std::uint32_t>(priceAndQuantity >> 32)),
+                                        static_cast<Quantity>(static_cast<std::uint32_t>(priceAndQuantity)),
+                                        static_cast<std::uint32_t>(orderCount) });
+        }
+    }
+
+    std::size_t depth_;
+    std::unique_ptr<std::atomic<std::uint64_t>[]> words_;
+    // Odd while a Publish is in progress; written by the book's thread only
+    alignas(CacheLineSize) std::atomic<std::uint64_t> sequence_{ 0 };
+};
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "orderbook.h"
+#include "orderbook_depth.h"
+#include "orderbook_journal.h"
+
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+using SymbolId = std::uint32_t;
+
+// --- OrderMessage Struct ---
+// Fixed 64-byte ingress record shared by the gateway rings, the manager and
+// recorded capture files, one cache line each. Every field has an explicit
+// width so the layout is identical across compilers; files are
+// little-endian. type_, orderType_ and side_ hold the underlying values of
+// MessageType, OrderType and Side. The mass cancels apply to the message's
+// symbol. SetRiskLimits lays its limits out as OrderRequest::SetRiskLimits
+// does, with the message window in time_. A Time message carries only
+// timestamp_, the new book time, so a gateway or scheduler can expire
+// orders between the messages around it. SessionEnd carries the new
+// session end in time_, and ExpireDay cancels every GoodForDay order.
+enum class MessageType : std::uint8_t
+{
+    Add = 1,
+    Cancel = 2,
+    Modify = 3,
+    CancelRange = 4,        // side_, price_ up to maxPrice_
+    CancelParticipant = 5,  // participant_
+    SetRiskLimits = 6,      // participant_ and its RiskLimits
+    BeginAuction = 7,       // price_, the reference price
+    EndAuction = 8,
+    Time = 9,
+    SessionEnd = 10,        // time_, the session end (0 clears it)
+    ExpireDay = 11
+};
+
+struct OrderMessage
+{
+    std::uint8_t type_;
+    std::uint8_t orderType_;    // Add only
+    std::uint8_t side_;         // Add and Modify
+    std::uint8_t reserved_;
+    std::int32_t price_;        // Add and Modify
+    std::int32_t quantity_;     // Add and Modify
+    SymbolId symbol_;
+    std::int64_t orderId_;
+    std::uint64_t timestamp_;   // Producer-defined, e.g. gateway receive time in ns
+    std::uint32_t participant_; // Add, CancelParticipant and SetRiskLimits; NoParticipant for an unowned order
+    std::int32_t maxPrice_;     // CancelRange only
+    std::uint64_t time_;        // Add, GoodTillTime only: the expiry; SetRiskLimits: the message window; SessionEnd: the session end
+    std::uint8_t spare_[16];    // Zero
+
+    static OrderMessage FromRequest(SymbolId symbol, const OrderRequest& request, std::uint64_t timestamp = 0)
+    {
+        OrderMessage message;
+        std::memset(&message, 0, sizeof(message));
+        switch(request.type_)
+        {
+        case RequestType::Add: message.type_ = static_cast<std::uint8_t>(MessageType::Add); break;
+        case RequestType::Cancel: message.type_ = static_cast<std::uint8_t>(MessageType::Cancel); break;
+        case RequestType::Modify: message.type_ = static_cast<std::uint8_t>(MessageType::Modify); break;
+        case RequestType::CancelRange: message.type_ = static_cast<std::uint8_t>(MessageType::CancelRange); break;
+        case RequestType::CancelParticipant: message.type_ = static_cast<std::uint8_t>(MessageType::CancelParticipant); break;
+        case RequestType::SetRiskLimits: message.type_ = static_cast<std::uint8_t>(MessageType::SetRiskLimits); break;
+        case RequestType::BeginAuction: message.type_ = static_cast<std::uint8_t>(MessageType::BeginAuction); break;
+        case RequestType::EndAuction: message.type_ = static_cast<std::uint8_t>(MessageType::EndAuction); break;
+        case RequestType::AdvanceTime:
+            message.type_ = static_cast<std::uint8_t>(MessageType::Time);
+            timestamp = request.time_;
+            break;
+        case RequestType::SetSessionEnd: message.type_ = static_cast<std::uint8_t>(MessageType::SessionEnd); break;
+        case RequestType::ExpireGoodForDay: message.type_ = static_cast<std::uint8_t>(MessageType::ExpireDay); break;
+        }
+        message.orderType_ = static_cast<std::uint8_t>(request.orderType_);
+        message.side_ = static_cast<std::uint8_t>(request.side_);
+        message.price_ = request.price_;
+        message.quantity_ = request.quantity_;
+        message.symbol_ = symbol;
+        message.orderId_ = request.orderId_;
+        message.timestamp_ = timestamp;
+        message.participant_ = request.participant_;
+        message.maxPrice_ = request.maxPrice_;
+        message.time_ = request.type_ == RequestType::Add || request.type_ == RequestType::SetRiskLimits
+            || request.type_ == RequestType::SetSessionEnd ? request.time_ : 0;
+        return message;
+    }
+
+    // False for a type, order type or side value this build does not know
+    bool ToRequest(OrderRequest& request) const
+    {
+        if(side_ > static_cast<std::uint8_t>(Side::Sell) || orderType_ > static_cast<std::uint8_t>(OrderType::GoodTillTime)){
+            return false;
+        }
+        switch(static_cast<MessageType>(type_))
+        {
+        case MessageType::Add: request.type_ = RequestType::Add; break;
+        case MessageType::Cancel: request.type_ = RequestType::Cancel; break;
+        case MessageType::Modify: request.type_ = RequestType::Modify; break;
+        case MessageType::CancelRange: request.type_ = RequestType::CancelRange; break;
+        case MessageType::CancelParticipant: request.type_ = RequestType::CancelParticipant; break;
+        case MessageType::SetRiskLimits: request.type_ = RequestType::SetRiskLimits; break;
+        case MessageType::BeginAuction: request.type_ = RequestType::BeginAuction; break;
+        case MessageType::EndAuction: request.type_ = RequestType::EndAuction; break;
+        case MessageType::Time: request.type_ = RequestType::AdvanceTime; break;
+        case MessageType::SessionEnd: request.type_ = RequestType::SetSessionEnd; break;
+        case MessageType::ExpireDay: request.type_ = RequestType::ExpireGoodForDay; break;
+        default: return false;
+        }
+        request.orderType_ = static_cast<OrderType>(orderType_);
+        request.side_ = static_cast<Side>(side_);
+        request.price_ = price_;
+        request.quantity_ = quantity_;
+        request.orderId_ = orderId_;
+        request.participant_ = participant_;
+        request.time_ = request.type_ == RequestType::AdvanceTime ? timestamp_ : time_;
+        request.maxPrice_ = maxPrice_;
+        return true;
+    }
+};
+
+static_assert(sizeof(OrderMessage) == 64, "OrderMessage is a fixed 64-byte record");
+static_assert(std::is_trivially_copyable<OrderMessage>::value, "OrderMessage must be memcpy-able");
+static_assert(std::is_standard_layout<OrderMessage>::value, "OrderMessage must have a fixed layout");
+
+// --- OrderbookEventLoop Class ---
+// Feeds one Orderbook from a lock-free SPSC ring of OrderMessages. The
+// gateway thread only copies 64 bytes into the ring (Post/TryPost); the
+// matching thread drains it with Poll or Run. Neither side ever takes a
+// mutex.
+class OrderbookEventLoop
+{
+public:
+    OrderbookEventLoop(Orderbook& orderbook, std::size_t queueCapacity)
+        : orderbook_{ orderbook }
+        , queue_{ queueCapacity }
+    {
+        trades_.reserve(1024);
+    }
+
+    // Producer side
+    bool TryPost(const OrderMessage& message) { return queue_.TryPush(message); }
+
+    void Post(const OrderMessage& message)
+    {
+        while(!queue_.TryPush(message)){
+            std::this_thread::yield();
+        }
+    }
+
+    // Once set, every well-formed message is appended to journal just before
+    // it is applied. Set before the consumer starts polling.
+    void SetJournal(OrderbookJournal* journal) { journal_ = journal; }
+
+    // Once set, the book's top levels are published after every applied
+    // message for readers on other threads. Set before polling starts.
+    void SetDepthPublisher(DepthPublisher* publisher) { publisher_ = publisher; }
+
+    // Every interval applied messages, the consumer captures a snapshot of
+    // the book tagged with the journal sequence and passes it to
+    // onSnapshot, which should hand it off to another thread to Write.
+    // Set before the consumer starts polling; interval 0 disables it.
+    void SetSnapshotPolicy(std::size_t interval, std::function<void(OrderbookSnapshot&&)> onSnapshot)
+    {
+        snapshotInterval_ = interval;
+        onSnapshot_ = std::move(onSnapshot);
+    }
+
+    // Consumer side: applies up to maxMessages queued messages and calls
+    // onTrades(const OrderMessage&, const Trades&) after each one that traded.
+    // Returns the number of messages taken off the ring.
+    template<typename OnTrades>
+    std::size_t Poll(OnTrades&& onTrades, std::size_t maxMessages = 64)
+    {
+        std::size_t count = 0;
+        while(count < maxMessages){
+            OrderMessage* message = queue_.Front();
+            if(!message){
+                break;
+            }
+            OrderRequest request;
+            if(message->ToRequest(request)){
+                if(journal_){
+                    journal_->Append(request);
+                }
+                trades_.clear();
+                orderbook_.ApplyBatch(&request, 1, trades_);
+                if(publisher_){
+                    publisher_->Publish(orderbook_);
+                }
+                if(!trades_.empty()){
+                    onTrades(*message, trades_);
+                }
+                if(snapshotInterval_ && ++sinceSnapshot_ == snapshotInterval_){
+                    sinceSnapshot_ = 0;
+                    onSnapshot_(OrderbookSnapshot::Capture(orderbook_, journal_ ? journal_->GetLastSequence() : 0));
+                }
+            }
+            else{
+                ++malformedCount_;
+            }
+            queue_.Pop();
+            ++count;
+        }
+        return count;
+    }
+
+    std::size_t Poll(std::size_t maxMessages = 64)
+    {
+        return Poll([](const OrderMessage&, const Trades&){}, maxMessages);
+    }
+
+    // Consumer side: polls until running is cleared and the ring is empty
+    template<typename OnTrades>
+    void Run(const std::atomic<bool>& running, OnTrades&& onTrades)
+    {
+        while(true){
+            if(Poll(onTrades)){
+                continue;
+            }
+            if(!running.load(std::memory_order_acquire) && queue_.IsEmpty()){
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    // Messages dropped because their type, order type or side was unknown
+    std::size_t GetMalformedCount() const { return malformedCount_; }
+
+private:
+    Orderbook& orderbook_;
+    SpscQueue<OrderMessage> queue_;
+    Trades trades_;
+    std::size_t malformedCount_{ 0 };
+    OrderbookJournal* journal_{ nullptr };
+    DepthPublisher* publisher_{ nullptr };
+    std::size_t snapshotInterval_{ 0 };
+    std::size_t sinceSnapshot_{ 0 };
+    std::function<void(OrderbookSnapshot&&)> onSnapshot_;
+};
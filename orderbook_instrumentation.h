@@ -0,0 +1,259 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Latency instrumentation for the matching path. Build with
+// -DORDERBOOK_INSTRUMENTATION=1 to timestamp each phase of AddOrder,
+// CancelOrder and ModifyOrder; by default every probe expands to nothing
+// and Orderbook carries no instrumentation state at all.
+#ifndef ORDERBOOK_INSTRUMENTATION
+#define ORDERBOOK_INSTRUMENTATION 0
+#endif
+
+// --- Probe Enum ---
+// Whole operations first, then the phases inside them
+enum class Probe : std::uint8_t
+{
+    AddOrder,
+    CancelOrder,
+    ModifyOrder,
+    DuplicateCheck,   // Id lookup plus the FAK pre-check
+    LevelInsert,      // Pool slot, level append and index insert
+    Matching,         // The matching loop or aggressive sweep itself
+    Count
+};
+
+inline const char* ToString(Probe probe)
+{
+    switch(probe)
+    {
+    case Probe::AddOrder: return "AddOrder";
+    case Probe::CancelOrder: return "CancelOrder";
+    case Probe::ModifyOrder: return "ModifyOrder";
+    case Probe::DuplicateCheck: return "  DuplicateCheck";
+    case Probe::LevelInsert: return "  LevelInsert";
+    case Probe::Matching: return "  Matching";
+    case Probe::Count: break;
+    }
+    return "?";
+}
+
+// --- InstrumentationClock ---
+// rdtsc where available (a few ns per read), steady_clock elsewhere. Ticks
+// are converted to nanoseconds only when a report is produced.
+struct InstrumentationClock
+{
+    static std::uint64_t Now()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    static double TicksPerNanosecond()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        static const double ticksPerNanosecond = []{
+            auto start = std::chrono::steady_clock::now();
+            std::uint64_t startTicks = __rdtsc();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            std::uint64_t ticks = __rdtsc() - startTicks;
+            double nanoseconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+            return static_cast<double>(ticks) / nanoseconds;
+        }();
+        return ticksPerNanosecond;
+#else
+        return 1.0;
+#endif
+    }
+};
+
+// --- LatencyHistogram Class ---
+// HDR-style log-linear histogram: exact below 32, then 32 sub-buckets per
+// power of two (about 3% relative error) up to 2^40 ticks. Recording is a
+// relaxed atomic increment, so any thread may read or dump it while the
+// matching thread records.
+class LatencyHistogram
+{
+public:
+    void Record(std::uint64_t value)
+    {
+        counts_[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        std::uint64_t max = max_.load(std::memory_order_relaxed);
+        while(value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)){
+        }
+    }
+
+    std::uint64_t GetCount() const { return count_.load(std::memory_order_relaxed); }
+    std::uint64_t GetMax() const { return max_.load(std::memory_order_relaxed); }
+
+    // Value at or below which the given fraction (0..1) of samples fall
+    std::uint64_t GetPercentile(double fraction) const
+    {
+        std::uint64_t count = GetCount();
+        if(count == 0){
+            return 0;
+        }
+        std::uint64_t target = static_cast<std::uint64_t>(fraction * static_cast<double>(count) + 0.5);
+        target = std::max<std::uint64_t>(target, 1);
+        std::uint64_t seen = 0;
+        for(std::size_t bucket = 0; bucket < BucketCount; ++bucket){
+            seen += counts_[bucket].load(std::memory_order_relaxed);
+            if(seen >= target){
+                return std::min(HighestValueOf(bucket), GetMax());
+            }
+        }
+        return GetMax();
+    }
+
+    void Reset()
+    {
+        for(auto& count : counts_){
+            count.store(0, std::memory_order_relaxed);
+        }
+        count_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr unsigned SubBucketBits = 5;
+    static constexpr std::uint64_t SubBucketCount = std::uint64_t{ 1 } << SubBucketBits;
+    static constexpr unsigned MaxValueBits = 40;
+    static constexpr std::size_t BucketCount = (MaxValueBits - SubBucketBits + 1) * SubBucketCount;
+
+    static std::size_t BucketOf(std::uint64_t value)
+    {
+        if(value >= (std::uint64_t{ 1 } << MaxValueBits)){
+            return BucketCount - 1;
+        }
+        if(value < SubBucketCount){
+            return static_cast<std::size_t>(value);
+        }
+        unsigned shift = 63 - static_cast<unsigned>(__builtin_clzll(value)) - SubBucketBits;
+        return static_cast<std::size_t>((shift + 1) * SubBucketCount + ((value >> shift) - SubBucketCount));
+    }
+
+    static std::uint64_t HighestValueOf(std::size_t bucket)
+    {
+        if(bucket < SubBucketCount){
+            return bucket;
+        }
+        unsigned shift = static_cast<unsigned>(bucket / SubBucketCount) - 1;
+        std::uint64_t subBucket = bucket % SubBucketCount + SubBucketCount;
+        return ((subBucket + 1) << shift) - 1;
+    }
+
+    std::atomic<std::uint64_t> counts_[BucketCount] = {};
+    std::atomic<std::uint64_t> count_{ 0 };
+    std::atomic<std::uint64_t> max_{ 0 };
+};
+
+// --- OrderbookInstrumentation Class ---
+class OrderbookInstrumentation
+{
+public:
+    void Record(Probe probe, std::uint64_t ticks)
+    {
+        histograms_[static_cast<std::size_t>(probe)].Record(ticks);
+    }
+
+    const LatencyHistogram& GetHistogram(Probe probe) const
+    {
+        return histograms_[static_cast<std::size_t>(probe)];
+    }
+
+    void Reset()
+    {
+        for(auto& histogram : histograms_){
+            histogram.Reset();
+        }
+    }
+
+    // One line per probe that has samples, in nanoseconds
+    void PrintReport(std::ostream& os) const
+    {
+        double ticksPerNanosecond = InstrumentationClock::TicksPerNanosecond();
+        auto nanoseconds = [ticksPerNanosecond](std::uint64_t ticks){
+            return static_cast<double>(ticks) / ticksPerNanosecond;
+        };
+        os << std::left << std::setw(18) << "Probe" << std::right
+           << std::setw(12) << "Count" << std::setw(10) << "p50" << std::setw(10) << "p99"
+           << std::setw(10) << "p99.9" << std::setw(12) << "max (ns)" << '\n';
+        for(std::size_t i = 0; i < static_cast<std::size_t>(Probe::Count); ++i){
+            const LatencyHistogram& histogram = histograms_[i];
+            if(histogram.GetCount() == 0){
+                continue;
+            }
+            os << std::left << std::setw(18) << ToString(static_cast<Probe>(i)) << std::right
+               << std::setw(12) << histogram.GetCount() << std::fixed << std::setprecision(0)
+               << std::setw(10) << nanoseconds(histogram.GetPercentile(0.50))
+               << std::setw(10) << nanoseconds(histogram.GetPercentile(0.99))
+               << std::setw(10) << nanoseconds(histogram.GetPercentile(0.999))
+               << std::setw(12) << nanoseconds(histogram.GetMax()) << '\n';
+        }
+    }
+
+private:
+    LatencyHistogram histograms_[static_cast<std::size_t>(Probe::Count)];
+};
+
+// --- ProbeTimer Class ---
+// Times one operation: each Lap records the time since the previous lap
+// under a phase probe, and the destructor records the whole span under
+// the operation probe (skipped when constructed with Probe::Count).
+class ProbeTimer
+{
+public:
+    ProbeTimer(OrderbookInstrumentation& instrumentation, Probe total)
+        : instrumentation_{ instrumentation }
+        , total_{ total }
+        , start_{ InstrumentationClock::Now() }
+        , lap_{ start_ }
+    {}
+
+    ProbeTimer(const ProbeTimer&) = delete;
+    ProbeTimer& operator=(const ProbeTimer&) = delete;
+
+    ~ProbeTimer()
+    {
+        if(total_ != Probe::Count){
+            instrumentation_.Record(total_, InstrumentationClock::Now() - start_);
+        }
+    }
+
+    void Lap(Probe phase)
+    {
+        std::uint64_t now = InstrumentationClock::Now();
+        instrumentation_.Record(phase, now - lap_);
+        lap_ = now;
+    }
+
+private:
+    OrderbookInstrumentation& instrumentation_;
+    Probe total_;
+    std::uint64_t start_;
+    std::uint64_t lap_;
+};
+
+#if ORDERBOOK_INSTRUMENTATION
+#define ORDERBOOK_PROBE_TIMER(name, total) ProbeTimer name{ instrumentation_, total }
+#define ORDERBOOK_PROBE_LAP(name, phase) name.Lap(phase)
+#else
+#define ORDERBOOK_PROBE_TIMER(name, total) ((void)0)
+#define ORDERBOOK_PROBE_LAP(name, phase) ((void)0)
+#endif
@@ -0,0 +1,618 @@
+#pragma once
+
+#include "orderbook.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <system_error>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Crash recovery for a single book: an append-only journal of the requests
+// the book applied, written from a background thread, and compact
+// snapshots of its resting orders. Matching is deterministic, so loading
+// the latest snapshot and replaying only the journal records after its
+// sequence number rebuilds the exact book, queue positions included.
+
+// O_DIRECT transfers must be aligned to the device block size
+constexpr std::size_t JournalBlockSize = 4096;
+
+namespace detail
+{
+    // Pass a previous result as hash to continue it over another buffer
+    inline std::uint32_t Fnv1a32(const void* data, std::size_t size, std::uint32_t hash = 2166136261u)
+    {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for(std::size_t i = 0; i < size; ++i){
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    inline void ThrowSystemError(int error, const std::string& what)
+    {
+        throw std::system_error{ error, std::generic_category(), what };
+    }
+
+    // Full-length pwrite, retrying short writes and EINTR; false sets errno
+    inline bool WriteFully(int fd, const char* data, std::size_t size, off_t offset)
+    {
+        while(size > 0){
+            ssize_t written = ::pwrite(fd, data, size, offset);
+            if(written < 0){
+                if(errno == EINTR){
+                    continue;
+                }
+                return false;
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+            offset += written;
+        }
+        return true;
+    }
+
+    // Read-only mapping of a whole file, unmapped on destruction
+    class MappedFile
+    {
+    public:
+        // populate faults the whole file in up front; otherwise the
+        // kernel's sequential read-ahead streams it in as it is walked
+        explicit MappedFile(const std::string& path, bool populate = true)
+        {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if(fd < 0){
+                ThrowSystemError(errno, path);
+            }
+            struct stat status;
+            if(::fstat(fd, &status) != 0){
+                int error = errno;
+                ::close(fd);
+                ThrowSystemError(error, path);
+            }
+            size_ = static_cast<std::size_t>(status.st_size);
+            if(size_ > 0){
+                data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | (populate ? MAP_POPULATE : 0), fd, 0);
+                if(data_ == MAP_FAILED){
+                    int error = errno;
+                    data_ = nullptr;
+                    ::close(fd);
+                    ThrowSystemError(error, path);
+                }
+                ::madvise(data_, size_, MADV_SEQUENTIAL);
+            }
+            ::close(fd);
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile()
+        {
+            if(data_){
+                ::munmap(data_, size_);
+            }
+        }
+
+        const char* GetData() const { return static_cast<const char*>(data_); }
+        std::size_t GetSize() const { return size_; }
+
+    private:
+        void* data_{ nullptr };
+        std::size_t size_{ 0 };
+    };
+}
+
+// --- JournalRecord Struct ---
+// One applied request, 64 bytes, little-endian. The checksum covers the
+// other 60 bytes so a torn write at the tail is detected on replay.
+// version_ is JournalFormatVersion; a record of any other version is not
+// decoded, so replay stops rather than misreading a journal written by a
+// different build.
+constexpr std::uint8_t JournalFormatVersion = 1;
+
+struct JournalRecord
+{
+    std::uint64_t sequence_;
+    std::int64_t orderId_;
+    std::uint64_t time_;        // Add: the GoodTillTime expiry; SetRiskLimits: the message window; AdvanceTime: the new book time; SetSessionEnd: the session end
+    std::int32_t price_;
+    std::int32_t quantity_;
+    std::uint32_t participant_; // Add, CancelParticipant and SetRiskLimits
+    std::uint8_t type_;         // RequestType
+    std::uint8_t orderType_;    // OrderType, Add only
+    std::uint8_t side_;         // Side, Add, Modify and CancelRange
+    std::uint8_t version_;
+    std::int32_t maxPrice_;     // CancelRange only
+    std::uint8_t reserved_[16];
+    std::uint32_t checksum_;
+
+    static JournalRecord FromRequest(std::uint64_t sequence, const OrderRequest& request)
+    {
+        JournalRecord record;
+        std::memset(&record, 0, sizeof(record));
+        record.sequence_ = sequence;
+        record.orderId_ = request.orderId_;
+        record.time_ = request.time_;
+        record.price_ = request.price_;
+        record.quantity_ = request.quantity_;
+        record.participant_ = request.participant_;
+        record.maxPrice_ = request.maxPrice_;
+        record.type_ = static_cast<std::uint8_t>(request.type_);
+        record.orderType_ = static_cast<std::uint8_t>(request.orderType_);
+        record.side_ = static_cast<std::uint8_t>(request.side_);
+        record.version_ = JournalFormatVersion;
+        record.checksum_ = record.ComputeChecksum();
+        return record;
+    }
+
+    std::uint32_t ComputeChecksum() const
+    {
+        return detail::Fnv1a32(this, offsetof(JournalRecord, checksum_));
+    }
+
+    // False for a torn record or one this build cannot decode
+    bool ToRequest(OrderRequest& request) const
+    {
+        if(checksum_ != ComputeChecksum()
+            || version_ != JournalFormatVersion
+            || type_ > static_cast<std::uint8_t>(RequestType::ExpireGoodForDay)
+            || orderType_ > static_cast<std::uint8_t>(OrderType::GoodTillTime)
+            || side_ > static_cast<std::uint8_t>(Side::Sell)){
+            return false;
+        }
+        request.type_ = static_cast<RequestType>(type_);
+        request.orderType_ = static_cast<OrderType>(orderType_);
+        request.side_ = static_cast<Side>(side_);
+        request.price_ = price_;
+        request.quantity_ = quantity_;
+        request.orderId_ = orderId_;
+        request.participant_ = participant_;
+        request.time_ = time_;
+        request.maxPrice_ = maxPrice_;
+        return true;
+    }
+};
+
+static_assert(sizeof(JournalRecord) == 64, "JournalRecord is a fixed 64-byte record");
+static_assert(JournalBlockSize % sizeof(JournalRecord) == 0, "Records must not straddle journal blocks");
+static_assert(std::is_trivially_copyable<JournalRecord>::value, "JournalRecord must be memcpy-able");
+
+// --- JournalOptions Struct ---
+struct JournalOptions
+{
+    std::size_t queueCapacity_{ 1 << 16 };   // Records in flight to the writer thread
+    std::size_t batchBytes_{ 1 << 20 };      // Write buffer, rounded up to whole blocks
+    bool directIo_{ false };                 // O_DIRECT: bypass the page cache
+    bool syncEachBatch_{ false };            // fdatasync after every write
+};
+
+// --- OrderbookJournal Class ---
+// Append-only request journal. The matching thread only copies a record
+// into an SPSC ring (Append); a writer thread gathers whatever has queued
+// up into one large buffer and writes it with a single pwrite, so a burst
+// of messages costs one system call. With directIo_, the partly filled
+// last block is rewritten in place by the next batch rather than padded,
+// and the file is trimmed to its exact length on close.
+//
+// Append must always be called from one thread, normally the one applying
+// the requests, right before it applies each one.
+class OrderbookJournal
+{
+public:
+    // Creates or truncates path; records are numbered from firstSequence
+    explicit OrderbookJournal(const std::string& path, std::uint64_t firstSequence = 1,
+                              const JournalOptions& options = JournalOptions{})
+        : options_{ options }
+        , queue_{ options.queueCapacity_ }
+        , lastSequence_{ firstSequence - 1 }
+        , bufferedSequence_{ firstSequence - 1 }
+        , writtenSequence_{ firstSequence - 1 }
+    {
+        int flags = O_WRONLY | O_CREAT | O_TRUNC;
+        if(options_.directIo_){
+#ifdef O_DIRECT
+            flags |= O_DIRECT;
+#else
+            throw std::invalid_argument("O_DIRECT is not available on this platform.");
+#endif
+        }
+        fd_ = ::open(path.c_str(), flags, 0644);
+        if(fd_ < 0){
+            detail::ThrowSystemError(errno, path);
+        }
+
+        capacity_ = (std::max(options_.batchBytes_, JournalBlockSize) + JournalBlockSize - 1) / JournalBlockSize * JournalBlockSize;
+        void* buffer = nullptr;
+        if(::posix_memalign(&buffer, JournalBlockSize, capacity_) != 0){
+            ::close(fd_);
+            throw std::bad_alloc{};
+        }
+        buffer_.reset(static_cast<char*>(buffer));
+
+        worker_ = std::thread{ [this]{ Run(); } };
+    }
+
+    OrderbookJournal(const OrderbookJournal&) = delete;
+    OrderbookJournal& operator=(const OrderbookJournal&) = delete;
+
+    // Writes everything still queued before closing the file
+    ~OrderbookJournal()
+    {
+        running_.store(false, std::memory_order_release);
+        worker_.join();
+        if(options_.directIo_){
+            if(::ftruncate(fd_, static_cast<off_t>(fileOffset_ + used_)) != 0){
+                // The zero tail of the last block is skipped on replay anyway
+            }
+        }
+        ::close(fd_);
+    }
+
+    // Returns the record's sequence number. Waits while the ring is full.
+    std::uint64_t Append(const OrderRequest& request)
+    {
+        const JournalRecord record = JournalRecord::FromRequest(lastSequence_ + 1, request);
+        while(!queue_.TryPush(record)){
+            std::this_thread::yield();
+        }
+        return ++lastSequence_;
+    }
+
+    // Producer side: the last sequence handed to Append
+    std::uint64_t GetLastSequence() const { return lastSequence_; }
+
+    // Last sequence the writer has handed to the file (and synced, with syncEachBatch_)
+    std::uint64_t GetWrittenSequence() const { return writtenSequence_.load(std::memory_order_acquire); }
+
+    // Producer side: waits until every appended record is written. Throws
+    // std::system_error if the writer thread hit an I/O error.
+    void Flush() const
+    {
+        while(GetWrittenSequence() < lastSequence_ && !error_.load(std::memory_order_acquire)){
+            std::this_thread::yield();
+        }
+        if(int error = error_.load(std::memory_order_acquire)){
+            throw std::system_error{ error, std::generic_category(), "Journal write failed" };
+        }
+    }
+
+private:
+    struct FreeDeleter
+    {
+        void operator()(char* memory) const { std::free(memory); }
+    };
+
+    void Run()
+    {
+        while(true){
+            bool gathered = false;
+            while(JournalRecord* record = queue_.Front()){
+                std::memcpy(buffer_.get() + used_, record, sizeof(JournalRecord));
+                used_ += sizeof(JournalRecord);
+                bufferedSequence_ = record->sequence_;
+                queue_.Pop();
+                gathered = true;
+                if(used_ == capacity_){
+                    WriteBuffer();
+                }
+            }
+            if(gathered){
+                WriteBuffer();
+                continue;
+            }
+            if(!running_.load(std::memory_order_acquire) && queue_.IsEmpty()){
+                return;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    // Writes buffer bytes [writtenBytes_, used_) at their file offset
+    void WriteBuffer()
+    {
+        if(used_ != writtenBytes_ && !error_.load(std::memory_order_relaxed)){
+            std::size_t begin = writtenBytes_;
+            std::size_t end = used_;
+            if(options_.directIo_){
+                begin = begin / JournalBlockSize * JournalBlockSize;
+                end = (end + JournalBlockSize - 1) / JournalBlockSize * JournalBlockSize;
+                std::memset(buffer_.get() + used_, 0, end - used_);
+            }
+            if(!detail::WriteFully(fd_, buffer_.get() + begin, end - begin, static_cast<off_t>(fileOffset_ + begin))
+                || (options_.syncEachBatch_ && ::fdatasync(fd_) != 0)){
+                error_.store(errno ? errno : EIO, std::memory_order_release);
+            }
+        }
+        writtenBytes_ = used_;
+        writtenSequence_.store(bufferedSequence_, std::memory_order_release);
+        if(used_ == capacity_){
+            fileOffset_ += capacity_;
+            used_ = 0;
+            writtenBytes_ = 0;
+        }
+    }
+
+    JournalOptions options_;
+    int fd_{ -1 };
+    SpscQueue<JournalRecord> queue_;
+    std::uint64_t lastSequence_;                 // Producer only
+
+    // Writer only
+    std::unique_ptr<char, FreeDeleter> buffer_;
+    std::size_t capacity_{ 0 };
+    std::size_t used_{ 0 };
+    std::size_t writtenBytes_{ 0 };
+    std::uint64_t fileOffset_{ 0 };
+    std::uint64_t bufferedSequence_;
+
+    alignas(64) std::atomic<std::uint64_t> writtenSequence_;
+    std::atomic<int> error_{ 0 };
+    std::atomic<bool> running_{ true };
+    std::thread worker_;
+};
+
+// Applies every journal record after afterSequence to orderbook, in order,
+// and returns the last sequence applied (afterSequence if none). Replay
+// stops at the first torn, out-of-sequence or zero-padding record, so a
+// journal cut short by a crash replays up to its last complete write.
+// Throws std::runtime_error if the journal starts after afterSequence + 1.
+inline std::uint64_t ReplayJournal(const std::string& path, Orderbook& orderbook, std::uint64_t afterSequence = 0)
+{
+    constexpr std::size_t ChunkSize = 256;
+
+    detail::MappedFile file{ path };
+    const auto* records = reinterpret_cast<const JournalRecord*>(file.GetData());
+    std::size_t recordCount = file.GetSize() / sizeof(JournalRecord);
+
+    OrderRequest requests[ChunkSize];
+    std::size_t pending = 0;
+    Trades trades;
+    std::uint64_t lastSequence = afterSequence;
+    std::uint64_t expected = recordCount > 0 ? records[0].sequence_ : 0;
+    if(recordCount > 0 && records[0].checksum_ == records[0].ComputeChecksum() && expected > afterSequence + 1){
+        throw std::runtime_error("Journal " + path + " starts at sequence " + std::to_string(expected)
+                                 + ", after " + std::to_string(afterSequence + 1) + ".");
+    }
+
+    for(std::size_t i = 0; i < recordCount; ++i, ++expected){
+        const JournalRecord& record = records[i];
+        if(record.sequence_ != expected || !record.ToRequest(requests[pending])){
+            break;
+        }
+        if(record.sequence_ <= afterSequence){
+            continue;
+        }
+        lastSequence = record.sequence_;
+        if(++pending == ChunkSize){
+            trades.clear();
+            orderbook.ApplyBatch(requests, pending, trades);
+            pending = 0;
+        }
+    }
+    trades.clear();
+    orderbook.ApplyBatch(requests, pending, trades);
+    return lastSequence;
+}
+
+// --- OrderbookSnapshot Class ---
+// Every resting order of one book in priority order (see
+// Orderbook::ForEachOrder) with the book time, session end, auction phase
+// and each participant's risk limits and message rate window, tagged with
+// the journal sequence of the last request applied before it was captured.
+// Capture must run on the thread that owns the book but is only a copy;
+// Write can then run on any thread.
+class OrderbookSnapshot
+{
+public:
+    struct Record
+    {
+        std::int64_t orderId_;
+        std::int32_t price_;
+        std::int32_t initialQuantity_;
+        std::int32_t remainingQuantity_;
+        std::uint32_t participant_;
+        std::uint8_t orderType_;
+        std::uint8_t side_;
+        std::uint8_t reserved_[6];
+        std::uint64_t expiry_;      // GoodTillTime only
+    };
+
+    static_assert(sizeof(Record) == 40, "Snapshot records are a fixed 40 bytes");
+
+    // One per participant, after the orders; the open order count and
+    // notional are not kept, they follow from the orders
+    struct ParticipantRecord
+    {
+        std::uint32_t participant_;
+        std::uint32_t maxOpenOrders_;
+        std::int64_t maxOpenNotional_;
+        std::uint32_t maxMessages_;
+        std::uint32_t windowMessages_;
+        std::uint64_t messageWindow_;
+        std::uint64_t windowStart_;
+    };
+
+    static_assert(sizeof(ParticipantRecord) == 40, "Snapshot participant records are a fixed 40 bytes");
+
+    static OrderbookSnapshot Capture(const Orderbook& orderbook, std::uint64_t sequence)
+    {
+        OrderbookSnapshot snapshot;
+        snapshot.sequence_ = sequence;
+        snapshot.tradeSequence_ = orderbook.GetTradeSequence();
+        snapshot.time_ = orderbook.GetTime();
+        snapshot.sessionEnd_ = orderbook.GetSessionEnd();
+        snapshot.auction_ = orderbook.IsInAuction();
+        snapshot.auctionReferencePrice_ = orderbook.GetAuctionReferencePrice();
+        snapshot.records_.reserve(orderbook.Size());
+        orderbook.ForEachOrder([&snapshot](const Order& order){
+            snapshot.records_.push_back(Record{ order.GetOrderId(), order.GetPrice(), order.GetInitialQuantity(),
+                                                order.GetRemainingQuantity(), order.GetParticipant(),
+                                                static_cast<std::uint8_t>(order.GetOrderType()),
+                                                static_cast<std::uint8_t>(order.GetSide()), {}, order.GetExpiry() });
+        });
+        orderbook.ForEachParticipant([&snapshot](ParticipantId participant, const ParticipantState& state){
+            snapshot.participants_.push_back(ParticipantRecord{ participant, state.limits_.maxOpenOrders_, state.limits_.maxOpenNotional_,
+                                                                state.limits_.maxMessages_, state.windowMessages_,
+                                                                state.limits_.messageWindow_, state.windowStart_ });
+        });
+        return snapshot;
+    }
+
+    // Writes to path + ".tmp", syncs and renames it over path, so a crash
+    // mid-write never replaces the previous snapshot with a partial one
+    void Write(const std::string& path) const
+    {
+        std::string temporaryPath = path + ".tmp";
+        int fd = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0){
+            detail::ThrowSystemError(errno, temporaryPath);
+        }
+        std::size_t recordBytes = records_.size() * sizeof(Record);
+        std::size_t participantBytes = participants_.size() * sizeof(ParticipantRecord);
+        Header header{ Magic, Version, sizeof(Record), sequence_, tradeSequence_, records_.size(), time_, sessionEnd_,
+                       Checksum(records_.data(), recordBytes, participants_.data(), participantBytes),
+                       static_cast<std::uint32_t>(participants_.size()), auctionReferencePrice_, auction_ ? 1u : 0u };
+        bool written = detail::WriteFully(fd, reinterpret_cast<const char*>(&header), sizeof(header), 0)
+            && detail::WriteFully(fd, reinterpret_cast<const char*>(records_.data()), recordBytes, sizeof(header))
+            && detail::WriteFully(fd, reinterpret_cast<const char*>(participants_.data()), participantBytes, sizeof(header) + recordBytes)
+            && ::fsync(fd) == 0;
+        int error = errno;
+        ::close(fd);
+        if(!written){
+            ::unlink(temporaryPath.c_str());
+            detail::ThrowSystemError(error, temporaryPath);
+        }
+        if(::rename(temporaryPath.c_str(), path.c_str()) != 0){
+            detail::ThrowSystemError(errno, path);
+        }
+    }
+
+    // Throws std::system_error if the file cannot be read and
+    // std::runtime_error if it is not an intact snapshot
+    static OrderbookSnapshot Load(const std::string& path)
+    {
+        detail::MappedFile file{ path };
+        Header header;
+        if(file.GetSize() < sizeof(header)){
+            throw std::runtime_error("Snapshot " + path + " is truncated.");
+        }
+        std::memcpy(&header, file.GetData(), sizeof(header));
+        // The count is checked by division first, so a corrupt count
+        // cannot overflow the size it is compared against
+        const std::size_t bodyBytes = file.GetSize() - sizeof(header);
+        if(header.magic_ != Magic || header.version_ != Version || header.recordSize_ != sizeof(Record)
+            || header.orderCount_ > bodyBytes / sizeof(Record)
+            || header.participantCount_ > (bodyBytes - header.orderCount_ * sizeof(Record)) / sizeof(ParticipantRecord)
+            || bodyBytes != header.orderCount_ * sizeof(Record) + header.participantCount_ * sizeof(ParticipantRecord)){
+            throw std::runtime_error("Snapshot " + path + " has an unknown format or is truncated.");
+        }
+        OrderbookSnapshot snapshot;
+        snapshot.sequence_ = header.sequence_;
+        snapshot.tradeSequence_ = header.tradeSequence_;
+        snapshot.time_ = header.time_;
+        snapshot.sessionEnd_ = header.sessionEnd_;
+        snapshot.auction_ = header.auction_ != 0;
+        snapshot.auctionReferencePrice_ = header.auctionReferencePrice_;
+        std::size_t recordBytes = header.orderCount_ * sizeof(Record);
+        std::size_t participantBytes = header.participantCount_ * sizeof(ParticipantRecord);
+        snapshot.records_.resize(header.orderCount_);
+        snapshot.participants_.resize(header.participantCount_);
+        if(recordBytes){
+            std::memcpy(snapshot.records_.data(), file.GetData() + sizeof(header), recordBytes);
+        }
+        if(participantBytes){
+            std::memcpy(snapshot.participants_.data(), file.GetData() + sizeof(header) + recordBytes, participantBytes);
+        }
+        if(Checksum(snapshot.records_.data(), recordBytes, snapshot.participants_.data(), participantBytes) != header.checksum_){
+            throw std::runtime_error("Snapshot " + path + " is corrupt.");
+        }
+        return snapshot;
+    }
+
+    // Rebuilds the book time, session end, auction phase, participants and
+    // resting orders into an empty book; orders captured during an auction
+    // may leave it crossed, as they were
+    void Restore(Orderbook& orderbook) const
+    {
+        orderbook.RestoreClock(time_, sessionEnd_);
+        if(auction_){
+            orderbook.BeginAuction(auctionReferencePrice_);
+        }
+        for(const ParticipantRecord& record : participants_){
+            orderbook.RestoreParticipant(record.participant_,
+                                         RiskLimits{ record.maxOpenOrders_, record.maxOpenNotional_, record.maxMessages_, record.messageWindow_ },
+                                         record.windowStart_, record.windowMessages_);
+        }
+        for(const Record& record : records_){
+            Order order{ static_cast<OrderType>(record.orderType_), record.orderId_, static_cast<Side>(record.side_),
+                         record.price_, record.initialQuantity_, record.participant_, record.expiry_ };
+            order.Fill(record.initialQuantity_ - record.remainingQuantity_);
+            orderbook.RestoreOrder(order);
+        }
+        orderbook.RestoreTradeSequence(tradeSequence_);
+    }
+
+    std::uint64_t GetSequence() const { return sequence_; }
+    std::size_t GetOrderCount() const { return records_.size(); }
+
+private:
+    struct Header
+    {
+        std::uint64_t magic_;
+        std::uint32_t version_;
+        std::uint32_t recordSize_;
+        std::uint64_t sequence_;
+        std::uint64_t tradeSequence_;
+        std::uint64_t orderCount_;
+        std::uint64_t time_;        // Orderbook::GetTime
+        std::uint64_t sessionEnd_;  // Orderbook::GetSessionEnd
+        std::uint32_t checksum_;    // Over the order records, then the participant records
+        std::uint32_t participantCount_;
+        std::int32_t auctionReferencePrice_;
+        std::uint32_t auction_;     // 1 when captured during an auction
+    };
+
+    static std::uint32_t Checksum(const Record* records, std::size_t recordBytes,
+                                  const ParticipantRecord* participants, std::size_t participantBytes)
+    {
+        return detail::Fnv1a32(participants, participantBytes, detail::Fnv1a32(records, recordBytes));
+    }
+
+    static constexpr std::uint64_t Magic = 0x50414e5342424f4full;   // "OOBBSNAP"
+    static constexpr std::uint32_t Version = 1;
+
+    std::uint64_t sequence_{ 0 };
+    std::uint64_t tradeSequence_{ 0 };
+    Timestamp time_{ 0 };
+    Timestamp sessionEnd_{ 0 };
+    bool auction_{ false };
+    Price auctionReferencePrice_{ 0 };
+    std::vector<Record> records_;
+    std::vector<ParticipantRecord> participants_;
+};
+
+// Rebuilds an empty book from a snapshot (skipped when snapshotPath is
+// empty) and the journal files written after it, oldest first. Returns the
+// last sequence applied; a new journal should continue from the next one.
+inline std::uint64_t RecoverOrderbook(Orderbook& orderbook, const std::string& snapshotPath,
+                                      const std::vector<std::string>& journalPaths)
+{
+    std::uint64_t sequence = 0;
+    if(!snapshotPath.empty()){
+        OrderbookSnapshot snapshot = OrderbookSnapshot::Load(snapshotPath);
+        snapshot.Restore(orderbook);
+        sequence = snapshot.GetSequence();
+    }
+    for(const std::string& journalPath : journalPaths){
+        sequence = ReplayJournal(journalPath, orderbook, sequence);
+    }
+    return sequence;
+}
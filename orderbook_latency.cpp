@@ -0,0 +1,285 @@
+#include "orderbook_workload.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Open-loop latency harness: a producer thread offers WorkloadGenerator
+// flow to an OrderbookEventLoop at a fixed rate, and the matching thread
+// records how long each message took to be applied, at a series of rising
+// rates until the book can no longer keep up.
+//
+//   ./orderbook_latency [--start-rate=N] [--max-rate=N] [--step=X] [--seconds=X]
+//                       [--poisson] [--queue=N] [--depth=N] [--levels=N] [--seed=N]
+//                       [--add=W --cancel=W --modify=W --fak=W] [--ladder-ticks=N] [--direct-ids]
+//                       [--producer-cpu=N --consumer-cpu=N]
+//
+// Every message has an intended send time on a fixed schedule (or Poisson
+// arrivals with --poisson). The producer never waits for the book: when it
+// falls behind it sends at once, and when the ring is full it retries.
+// Latency is measured from the intended send time, so a stall charges
+// every message that should have gone out during it rather than only the
+// one caught in it, which is the coordinated-omission correction. The
+// uncorrected column measures from the moment the message actually entered
+// the ring, as a closed-loop client would see it.
+//
+// A step is saturated once achieved throughput falls below 98% of the
+// offered rate; the sweep stops after the first such step.
+
+namespace
+{
+    struct LatencyOptions
+    {
+        double startRate_{ 100000 };
+        double maxRate_{ 50000000 };
+        double step_{ 1.5 };
+        double seconds_{ 1.0 };
+        bool poisson_{ false };
+        std::size_t queueCapacity_{ 65536 };
+        WorkloadConfig workload_{};
+        Price ladderTicks_{ 0 };
+        bool directIds_{ false };
+        int producerCpu_{ -1 };
+        int consumerCpu_{ -1 };
+    };
+
+    bool ParseOption(const char* arg, const char* name, double& value)
+    {
+        std::size_t length = std::strlen(name);
+        if(std::strncmp(arg, name, length) != 0 || arg[length] != '='){
+            return false;
+        }
+        value = std::atof(arg + length + 1);
+        return true;
+    }
+
+    bool ParseOptions(int argc, char** argv, LatencyOptions& options)
+    {
+        WorkloadConfig& workload = options.workload_;
+        for(int i = 1; i < argc; ++i){
+            double value = 0;
+            const char* arg = argv[i];
+            if(std::strcmp(arg, "--poisson") == 0){
+                options.poisson_ = true;
+            }
+            else if(std::strcmp(arg, "--direct-ids") == 0){
+                options.directIds_ = true;
+            }
+            else if(ParseOption(arg, "--start-rate", value)){
+                options.startRate_ = value;
+            }
+            else if(ParseOption(arg, "--max-rate", value)){
+                options.maxRate_ = value;
+            }
+            else if(ParseOption(arg, "--step", value)){
+                options.step_ = value;
+            }
+            else if(ParseOption(arg, "--seconds", value)){
+                options.seconds_ = value;
+            }
+            else if(ParseOption(arg, "--queue", value)){
+                options.queueCapacity_ = static_cast<std::size_t>(value);
+            }
+            else if(ParseOption(arg, "--depth", value)){
+                workload.depth_ = static_cast<std::size_t>(value);
+            }
+            else if(ParseOption(arg, "--levels", value)){
+                workload.levels_ = static_cast<Price>(value);
+            }
+            else if(ParseOption(arg, "--seed", value)){
+                workload.seed_ = static_cast<std::uint64_t>(value);
+            }
+            else if(ParseOption(arg, "--add", value)){
+                workload.addWeight_ = value;
+            }
+            else if(ParseOption(arg, "--cancel", value)){
+                workload.cancelWeight_ = value;
+            }
+            else if(ParseOption(arg, "--modify", value)){
+                workload.modifyWeight_ = value;
+            }
+            else if(ParseOption(arg, "--fak", value)){
+                workload.fillAndKillWeight_ = value;
+            }
+            else if(ParseOption(arg, "--ladder-ticks", value)){
+                options.ladderTicks_ = static_cast<Price>(value);
+            }
+            else if(ParseOption(arg, "--producer-cpu", value)){
+                options.producerCpu_ = static_cast<int>(value);
+            }
+            else if(ParseOption(arg, "--consumer-cpu", value)){
+                options.consumerCpu_ = static_cast<int>(value);
+            }
+            else{
+                return false;
+            }
+        }
+        return options.startRate_ > 0 && options.step_ > 1 && options.seconds_ > 0;
+    }
+
+    void PinCurrentThread(int cpu)
+    {
+#ifdef __linux__
+        if(cpu < 0){
+            return;
+        }
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#else
+        (void)cpu;
+#endif
+    }
+
+    struct StepResult
+    {
+        double offeredRate_{ 0 };
+        double achievedRate_{ 0 };
+        LatencyHistogram corrected_;
+        LatencyHistogram uncorrected_;
+        LatencyHistogram trades_;    // Intended send time to trade emission
+    };
+
+    // Builds a fresh book to depth, then offers options.seconds_ worth of
+    // flow at rate and records every message's latency
+    void RunStep(const LatencyOptions& options, double rate, StepResult& result)
+    {
+        WorkloadConfig workload = options.workload_;
+        workload.rate_ = options.poisson_ ? rate : 0;
+        WorkloadGenerator generator{ workload };
+
+        OrderbookConfig bookConfig;
+        bookConfig.orderCapacity_ = workload.depth_ * 4;
+        bookConfig.referencePrice_ = workload.midPrice_;
+        bookConfig.ladderTicks_ = options.ladderTicks_;
+        if(options.directIds_){
+            bookConfig.orderIndexMode_ = OrderIndexMode::Direct;
+            bookConfig.baseOrderId_ = workload.firstOrderId_;
+        }
+        Orderbook orderbook{ bookConfig };
+        Trades trades;
+        for(std::size_t i = 0; i < generator.GetWarmupCount(); ++i){
+            OrderRequest request;
+            generator.Next().ToRequest(request);
+            trades.clear();
+            orderbook.ApplyBatch(&request, 1, trades);
+        }
+
+        // Messages and their schedule, in clock ticks from the start, are
+        // fixed before either thread runs
+        double ticksPerSecond = InstrumentationClock::TicksPerNanosecond() * 1e9;
+        std::size_t count = std::max<std::size_t>(static_cast<std::size_t>(rate * options.seconds_), 1);
+        std::vector<OrderMessage> messages(count);
+        std::vector<std::uint64_t> intended(count);
+        std::vector<std::uint64_t> enqueued(count);
+        for(std::size_t i = 0; i < count; ++i){
+            messages[i] = generator.Next();
+            double offset = options.poisson_ ? static_cast<double>(messages[i].timestamp_) * 1e-9 * ticksPerSecond
+                                             : static_cast<double>(i) * ticksPerSecond / rate;
+            intended[i] = static_cast<std::uint64_t>(offset);
+        }
+
+        OrderbookEventLoop loop{ orderbook, options.queueCapacity_ };
+        // Both threads start from the same clock reading, a little ahead so
+        // neither begins behind schedule
+        std::uint64_t start = InstrumentationClock::Now() + static_cast<std::uint64_t>(ticksPerSecond * 0.01);
+        std::uint64_t finish = 0;
+
+        std::thread consumer{ [&]{
+            PinCurrentThread(options.consumerCpu_);
+            std::size_t index = 0;
+            std::uint64_t tradeTicks = 0;
+            auto onTrades = [&tradeTicks](const OrderMessage&, const Trades&){
+                tradeTicks = InstrumentationClock::Now();
+            };
+            while(index < count){
+                tradeTicks = 0;
+                if(!loop.Poll(onTrades, 1)){
+                    continue;
+                }
+                std::uint64_t now = InstrumentationClock::Now();
+                std::uint64_t due = start + intended[index];
+                result.corrected_.Record(now - due);
+                result.uncorrected_.Record(now - enqueued[index]);
+                if(tradeTicks){
+                    result.trades_.Record(tradeTicks - due);
+                }
+                ++index;
+            }
+            finish = InstrumentationClock::Now();
+        } };
+
+        PinCurrentThread(options.producerCpu_);
+        for(std::size_t i = 0; i < count; ++i){
+            std::uint64_t due = start + intended[i];
+            while(InstrumentationClock::Now() < due){
+            }
+            // The stamp from the attempt that succeeds is published with the
+            // message by the ring's release store
+            while(true){
+                enqueued[i] = InstrumentationClock::Now();
+                messages[i].timestamp_ = enqueued[i];
+                if(loop.TryPost(messages[i])){
+                    break;
+                }
+            }
+        }
+        consumer.join();
+
+        double seconds = static_cast<double>(finish - start) / ticksPerSecond;
+        result.offeredRate_ = rate;
+        result.achievedRate_ = seconds > 0 ? static_cast<double>(count) / seconds : 0.0;
+    }
+}
+
+// --- Main Latency Harness Logic ---
+int main(int argc, char** argv){
+    LatencyOptions options;
+    if(!ParseOptions(argc, argv, options)){
+        std::fprintf(stderr, "usage: %s [--start-rate=N] [--max-rate=N] [--step=X] [--seconds=X]\n"
+                             "       [--poisson] [--queue=N] [--depth=N] [--levels=N] [--seed=N]\n"
+                             "       [--add=W --cancel=W --modify=W --fak=W] [--ladder-ticks=N] [--direct-ids]\n"
+                             "       [--producer-cpu=N --consumer-cpu=N]\n", argv[0]);
+        return 2;
+    }
+
+    if(std::thread::hardware_concurrency() < 2){
+        std::fprintf(stderr, "warning: producer and matching thread share one CPU; latencies will reflect time slicing\n");
+    }
+
+    double ticksPerNanosecond = InstrumentationClock::TicksPerNanosecond();
+    auto nanoseconds = [ticksPerNanosecond](std::uint64_t ticks){
+        return static_cast<double>(ticks) / ticksPerNanosecond;
+    };
+
+    std::printf("%s arrivals, %s levels, %s ids, %zu orders per side\n\n", options.poisson_ ? "poisson" : "fixed-rate",
+                options.ladderTicks_ > 0 ? "ladder" : "map", options.directIds_ ? "direct" : "hashed",
+                options.workload_.depth_);
+    std::printf("%12s %12s %10s %10s %10s %10s %12s %12s %12s\n", "offered/s", "achieved/s", "p50", "p90", "p99",
+                "p99.9", "max", "p99 uncorr", "p99 trade");
+    for(double rate = options.startRate_; rate <= options.maxRate_; rate *= options.step_){
+        StepResult result;
+        RunStep(options, rate, result);
+        bool saturated = result.achievedRate_ < 0.98 * result.offeredRate_;
+        const LatencyHistogram& corrected = result.corrected_;
+        std::printf("%12.0f %12.0f %10.0f %10.0f %10.0f %10.0f %12.0f %12.0f %12.0f%s\n",
+                    result.offeredRate_, result.achievedRate_,
+                    nanoseconds(corrected.GetPercentile(0.50)), nanoseconds(corrected.GetPercentile(0.90)),
+                    nanoseconds(corrected.GetPercentile(0.99)), nanoseconds(corrected.GetPercentile(0.999)),
+                    nanoseconds(corrected.GetMax()), nanoseconds(result.uncorrected_.GetPercentile(0.99)),
+                    nanoseconds(result.trades_.GetPercentile(0.99)), saturated ? "  saturated" : "");
+        std::fflush(stdout);
+        if(saturated){
+            break;
+        }
+    }
+    std::printf("\nlatencies in ns from intended send time unless marked uncorr (from actual enqueue)\n");
+    return 0;
+}
@@ -0,0 +1,243 @@
+#include "orderbook_workload.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Drives one Orderbook with synthetic flow from WorkloadGenerator and
+// reports sustained throughput and per-message service time percentiles,
+// broken down by kind of flow. With --write the flow is saved as an
+// OrderMessage capture for orderbook_replay instead.
+//
+//   ./orderbook_loadgen [--messages=N] [--seed=N] [--depth=N] [--levels=N] [--exponent=X]
+//                       [--add=W --cancel=W --modify=W --fak=W] [--max-quantity=N]
+//                       [--rate=MSGS_PER_SEC --burst-probability=P --burst-multiplier=X --burst-length=N]
+//                       [--ladder-ticks=N] [--direct-ids] [--write=capture.bin]
+//
+// --rate paces messages to their scheduled arrival times by spinning;
+// without it the book is driven as fast as it accepts messages. Latency is
+// the time each message takes inside the book, measured after warm-up.
+
+namespace
+{
+    struct LoadgenOptions
+    {
+        std::size_t messages_{ 1000000 };
+        WorkloadConfig workload_{};
+        Price ladderTicks_{ 0 };
+        bool directIds_{ false };
+        const char* writePath_{ nullptr };
+    };
+
+    bool ParseOption(const char* arg, const char* name, double& value)
+    {
+        std::size_t length = std::strlen(name);
+        if(std::strncmp(arg, name, length) != 0 || arg[length] != '='){
+            return false;
+        }
+        value = std::atof(arg + length + 1);
+        return true;
+    }
+
+    bool ParseOptions(int argc, char** argv, LoadgenOptions& options)
+    {
+        WorkloadConfig& workload = options.workload_;
+        for(int i = 1; i < argc; ++i){
+            double value = 0;
+            const char* arg = argv[i];
+            if(std::strcmp(arg, "--direct-ids") == 0){
+                options.directIds_ = true;
+            }
+            else if(std::strncmp(arg, "--write=", 8) == 0){
+                options.writePath_ = arg + 8;
+            }
+            else if(ParseOption(arg, "--messages", value)){
+                options.messages_ = static_cast<std::size_t>(value);
+            }
+            else if(ParseOption(arg, "--seed", value)){
+                workload.seed_ = static_cast<std::uint64_t>(value);
+            }
+            else if(ParseOption(arg, "--depth", value)){
+                workload.depth_ = static_cast<std::size_t>(value);
+            }
+            else if(ParseOption(arg, "--levels", value)){
+                workload.levels_ = static_cast<Price>(value);
+            }
+            else if(ParseOption(arg, "--exponent", value)){
+                workload.distanceExponent_ = value;
+            }
+            else if(ParseOption(arg, "--max-quantity", value)){
+                workload.maxQuantity_ = static_cast<Quantity>(value);
+            }
+            else if(ParseOption(arg, "--add", value)){
+                workload.addWeight_ = value;
+            }
+            else if(ParseOption(arg, "--cancel", value)){
+                workload.cancelWeight_ = value;
+            }
+            else if(ParseOption(arg, "--modify", value)){
+                workload.modifyWeight_ = value;
+            }
+            else if(ParseOption(arg, "--fak", value)){
+                workload.fillAndKillWeight_ = value;
+            }
+            else if(ParseOption(arg, "--rate", value)){
+                workload.rate_ = value;
+            }
+            else if(ParseOption(arg, "--burst-probability", value)){
+                workload.burstProbability_ = value;
+            }
+            else if(ParseOption(arg, "--burst-multiplier", value)){
+                workload.burstMultiplier_ = value;
+            }
+            else if(ParseOption(arg, "--burst-length", value)){
+                workload.burstLength_ = value;
+            }
+            else if(ParseOption(arg, "--ladder-ticks", value)){
+                options.ladderTicks_ = static_cast<Price>(value);
+            }
+            else{
+                return false;
+            }
+        }
+        return true;
+    }
+
+    class CountingSink : public NullEventSink
+    {
+    public:
+        void OnOrderRejected(OrderId, RejectReason) override { ++rejected_; }
+
+        std::uint64_t rejected_{ 0 };
+    };
+
+    int WriteCapture(const LoadgenOptions& options)
+    {
+        std::FILE* file = std::fopen(options.writePath_, "wb");
+        if(!file){
+            std::perror(options.writePath_);
+            return 1;
+        }
+        WorkloadGenerator generator{ options.workload_ };
+        std::size_t total = generator.GetWarmupCount() + options.messages_;
+        for(std::size_t i = 0; i < total; ++i){
+            OrderMessage message = generator.Next();
+            if(std::fwrite(&message, sizeof(message), 1, file) != 1){
+                std::perror(options.writePath_);
+                std::fclose(file);
+                return 1;
+            }
+        }
+        if(std::fclose(file) != 0){
+            std::perror(options.writePath_);
+            return 1;
+        }
+        std::printf("wrote %zu messages (%zu warm-up) to %s\n", total, generator.GetWarmupCount(), options.writePath_);
+        return 0;
+    }
+}
+
+// --- Main Load Generator Logic ---
+int main(int argc, char** argv){
+    LoadgenOptions options;
+    if(!ParseOptions(argc, argv, options)){
+        std::fprintf(stderr, "usage: %s [--messages=N] [--seed=N] [--depth=N] [--levels=N] [--exponent=X]\n"
+                             "       [--add=W --cancel=W --modify=W --fak=W] [--max-quantity=N]\n"
+                             "       [--rate=MSGS_PER_SEC --burst-probability=P --burst-multiplier=X --burst-length=N]\n"
+                             "       [--ladder-ticks=N] [--direct-ids] [--write=capture.bin]\n", argv[0]);
+        return 2;
+    }
+    if(options.writePath_){
+        return WriteCapture(options);
+    }
+
+    const WorkloadConfig& workload = options.workload_;
+    OrderbookConfig bookConfig;
+    bookConfig.orderCapacity_ = workload.depth_ * 4;
+    bookConfig.referencePrice_ = workload.midPrice_;
+    bookConfig.ladderTicks_ = options.ladderTicks_;
+    if(options.directIds_){
+        bookConfig.orderIndexMode_ = OrderIndexMode::Direct;
+        bookConfig.baseOrderId_ = workload.firstOrderId_;
+    }
+    Orderbook orderbook{ bookConfig };
+    CountingSink sink;
+    orderbook.SetEventSink(&sink);
+
+    std::uint64_t tradeCount = 0;
+    auto onTrade = [&tradeCount](const Trade&){ ++tradeCount; };
+    // Decoded and applied exactly as the event loop does, one message per
+    // batch so each one can be timed
+    auto apply = [&](const OrderMessage& message){
+        OrderRequest request;
+        if(message.ToRequest(request)){
+            orderbook.ApplyBatch(&request, 1, onTrade);
+        }
+    };
+
+    WorkloadGenerator generator{ workload };
+    for(std::size_t i = 0; i < generator.GetWarmupCount(); ++i){
+        apply(generator.Next());
+    }
+    tradeCount = 0;
+    sink.rejected_ = 0;
+
+    // Generated up front so the generator's own cost stays out of the run
+    std::vector<OrderMessage> messages;
+    std::vector<WorkloadMessageKind> kinds;
+    messages.reserve(options.messages_);
+    kinds.reserve(options.messages_);
+    for(std::size_t i = 0; i < options.messages_; ++i){
+        WorkloadMessageKind kind;
+        messages.push_back(generator.Next(kind));
+        kinds.push_back(kind);
+    }
+
+    LatencyHistogram histograms[static_cast<std::size_t>(WorkloadMessageKind::Count)];
+    LatencyHistogram overall;
+    auto start = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < messages.size(); ++i){
+        if(workload.rate_ > 0){
+            auto due = start + std::chrono::nanoseconds{ messages[i].timestamp_ };
+            while(std::chrono::steady_clock::now() < due){
+            }
+        }
+        std::uint64_t begin = InstrumentationClock::Now();
+        apply(messages[i]);
+        std::uint64_t ticks = InstrumentationClock::Now() - begin;
+        histograms[static_cast<std::size_t>(kinds[i])].Record(ticks);
+        overall.Record(ticks);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("messages:        %zu after %zu warm-up\n", messages.size(), generator.GetWarmupCount());
+    std::printf("backend:         %s levels, %s ids\n", options.ladderTicks_ > 0 ? "ladder" : "map",
+                options.directIds_ ? "direct" : "hashed");
+    std::printf("elapsed:         %.3f s\n", seconds);
+    std::printf("throughput:      %.0f msgs/sec\n", seconds > 0 ? static_cast<double>(messages.size()) / seconds : 0.0);
+    std::printf("trades:          %llu\n", static_cast<unsigned long long>(tradeCount));
+    std::printf("rejects:         %llu\n", static_cast<unsigned long long>(sink.rejected_));
+    std::printf("resting orders:  %zu\n\n", orderbook.Size());
+
+    double ticksPerNanosecond = InstrumentationClock::TicksPerNanosecond();
+    auto nanoseconds = [ticksPerNanosecond](std::uint64_t ticks){
+        return static_cast<double>(ticks) / ticksPerNanosecond;
+    };
+    auto printRow = [&](const char* name, const LatencyHistogram& histogram){
+        if(histogram.GetCount() == 0){
+            return;
+        }
+        std::printf("%-14s %10llu %8.0f %8.0f %8.0f %8.0f %10.0f\n", name,
+                    static_cast<unsigned long long>(histogram.GetCount()),
+                    nanoseconds(histogram.GetPercentile(0.50)), nanoseconds(histogram.GetPercentile(0.90)),
+                    nanoseconds(histogram.GetPercentile(0.99)), nanoseconds(histogram.GetPercentile(0.999)),
+                    nanoseconds(histogram.GetMax()));
+    };
+    std::printf("%-14s %10s %8s %8s %8s %8s %10s\n", "Kind", "Count", "p50", "p90", "p99", "p99.9", "max (ns)");
+    for(std::size_t i = 0; i < static_cast<std::size_t>(WorkloadMessageKind::Count); ++i){
+        printRow(ToString(static_cast<WorkloadMessageKind>(i)), histograms[i]);
+    }
+    printRow("All", overall);
+    return 0;
+}
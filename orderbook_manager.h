@@ -0,0 +1,303 @@
+#pragma once
+
+#include "orderbook_ingress.h"
+
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// --- OrderbookManagerConfig Struct ---
+struct OrderbookManagerConfig
+{
+    std::size_t shardCount_{ 1 };
+    std::size_t queueCapacity_{ 1 << 16 };   // Messages per shard ingress ring
+    // Used for symbols that were not registered explicitly
+    OrderbookConfig defaultBookConfig_{};
+    // Pins shard i to CPU firstCpu_ + i (Linux only). Start throws if a
+    // CPU is out of range or not allowed for this process.
+    bool pinThreads_{ false };
+    int firstCpu_{ 0 };
+};
+
+// --- OrderbookManager Class ---
+// Owns one Orderbook per symbol and partitions symbols across worker
+// threads (symbol % shardCount). Every shard has its own SPSC ingress ring
+// and trade buffer, and its books are constructed on the worker thread
+// itself so their pools are first touched, and therefore allocated, on
+// that core's memory. Nothing on the matching path takes a lock, so
+// uncorrelated symbols scale with the number of shards.
+//
+// Submit must always be called from one producer thread. The TradeHandler
+// runs on the worker threads, once per message that produced trades.
+class OrderbookManager
+{
+public:
+    using TradeHandler = std::function<void(SymbolId, const Trades&)>;
+
+    explicit OrderbookManager(const OrderbookManagerConfig& config, TradeHandler onTrades = {})
+        : config_{ config }
+        , onTrades_{ std::move(onTrades) }
+    {
+        shards_.reserve(config_.shardCount_);
+        for(std::size_t i = 0; i < config_.shardCount_; ++i){
+            shards_.push_back(std::make_unique<Shard>(config_.queueCapacity_));
+        }
+    }
+
+    OrderbookManager(const OrderbookManager&) = delete;
+    OrderbookManager& operator=(const OrderbookManager&) = delete;
+
+    ~OrderbookManager()
+    {
+        Stop();
+    }
+
+    // Must be called before Start; the pending list is read by the workers
+    void RegisterSymbol(SymbolId symbol, const OrderbookConfig& config)
+    {
+        if(workersRunning_){
+            throw std::logic_error("Symbol (" + std::to_string(symbol) + ") registered after the workers started.");
+        }
+        Shard& shard = ShardOf(symbol);
+        shard.pendingSymbols_.push_back({ symbol, config });
+    }
+
+    // Returns once every worker has built its registered books, so they
+    // can be inspected straight away. If a worker could not be pinned, every
+    // worker is stopped again and Start throws.
+    void Start()
+    {
+        workersRunning_ = true;
+        for(std::size_t i = 0; i < shards_.size(); ++i){
+            Shard& shard = *shards_[i];
+            shard.running_.store(true, std::memory_order_relaxed);
+            shard.worker_ = std::thread{ [this, &shard, i]{ Run(shard, i); } };
+        }
+        for(const auto& shard : shards_){
+            while(!shard->started_.load(std::memory_order_acquire)){
+                std::this_thread::yield();
+            }
+        }
+        for(std::size_t i = 0; i < shards_.size(); ++i){
+            if(!shards_[i]->pinned_){
+                Stop();
+                throw std::runtime_error("Shard (" + std::to_string(i) + ") could not be pinned to CPU " + std::to_string(config_.firstCpu_ + static_cast<int>(i)) + ".");
+            }
+        }
+    }
+
+    // Drains every queue, then joins the workers
+    void Stop()
+    {
+        for(auto& shard : shards_){
+            shard->running_.store(false, std::memory_order_release);
+        }
+        for(auto& shard : shards_){
+            if(shard->worker_.joinable()){
+                shard->worker_.join();
+            }
+        }
+        workersRunning_ = false;
+    }
+
+    // Producer side. Waits while the shard's ring is full.
+    void Submit(const OrderMessage& message)
+    {
+        Shard& shard = ShardOf(message.symbol_);
+        while(!shard.queue_.TryPush(message)){
+            std::this_thread::yield();
+        }
+        ++shard.submitted_;
+    }
+
+    void Submit(SymbolId symbol, const OrderRequest& request)
+    {
+        Submit(OrderMessage::FromRequest(symbol, request));
+    }
+
+    // Producer side: moves every book to book time now, expiring the orders
+    // due by then between the messages submitted before and after it. A
+    // scheduler on the producer thread calls it, e.g. once per expiry
+    // tick. A Time message submitted directly advances every book of the
+    // shard its symbol maps to. Books created later start at the shard's
+    // latest time.
+    void AdvanceTime(Timestamp now)
+    {
+        for(std::size_t i = 0; i < shards_.size(); ++i){
+            Submit(OrderMessage::FromRequest(static_cast<SymbolId>(i), OrderRequest::AdvanceTime(now)));
+        }
+    }
+
+    // Producer side: sets the session end of every book, fanned out like
+    // AdvanceTime; GoodForDay orders then expire once AdvanceTime reaches
+    // it. Books created later take the shard's latest session end.
+    void SetSessionEnd(Timestamp end)
+    {
+        for(std::size_t i = 0; i < shards_.size(); ++i){
+            Submit(OrderMessage::FromRequest(static_cast<SymbolId>(i), OrderRequest::SetSessionEnd(end)));
+        }
+    }
+
+    // Producer side: cancels every resting GoodForDay order in every book
+    void ExpireGoodForDayOrders()
+    {
+        for(std::size_t i = 0; i < shards_.size(); ++i){
+            Submit(OrderMessage::FromRequest(static_cast<SymbolId>(i), OrderRequest::ExpireGoodForDay()));
+        }
+    }
+
+    // Producer side: blocks until every submitted message has been applied.
+    // Afterwards the books may be inspected until the next Submit.
+    void Flush() const
+    {
+        for(const auto& shard : shards_){
+            while(shard->processed_.load(std::memory_order_acquire) != shard->submitted_){
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Only safe while the workers are idle (after Flush or Stop)
+    const Orderbook* GetOrderbook(SymbolId symbol) const
+    {
+        const Shard& shard = *shards_[symbol % shards_.size()];
+        auto book = shard.books_.find(symbol);
+        return book != shard.books_.end() ? book->second.get() : nullptr;
+    }
+
+    std::size_t GetShardCount() const { return shards_.size(); }
+
+private:
+    static constexpr std::size_t CacheLineSize = 64;
+
+    struct Shard
+    {
+        explicit Shard(std::size_t queueCapacity)
+            : queue_{ queueCapacity }
+        {}
+
+        SpscQueue<OrderMessage> queue_;
+        std::vector<std::pair<SymbolId, OrderbookConfig>> pendingSymbols_;
+        // Symbols are sparse, so books are keyed rather than indexed by id;
+        // only touched by the worker
+        std::unordered_map<SymbolId, std::unique_ptr<Orderbook>> books_;
+        Trades trades_;
+        Timestamp time_{ 0 };          // Latest AdvanceTime; only touched by the worker
+        Timestamp sessionEnd_{ 0 };    // Latest SetSessionEnd; only touched by the worker
+        std::size_t submitted_{ 0 };   // Producer only
+        // Shards come from make_unique, which under C++14 does not honour
+        // over-alignment, so processed_ is kept off the producer's and the
+        // neighbouring lines by padding rather than alignas
+        char submittedPad_[CacheLineSize];
+        std::atomic<std::size_t> processed_{ 0 };
+        char processedPad_[CacheLineSize];
+        std::atomic<bool> running_{ false };
+        bool pinned_{ false };   // Written by the worker before started_
+        std::atomic<bool> started_{ false };
+        std::thread worker_;
+    };
+
+    Shard& ShardOf(SymbolId symbol) { return *shards_[symbol % shards_.size()]; }
+
+    Orderbook& BookOf(Shard& shard, SymbolId symbol, const OrderbookConfig& config)
+    {
+        std::unique_ptr<Orderbook>& book = shard.books_[symbol];
+        if(!book){
+            book = std::make_unique<Orderbook>(config);
+            book->SetSessionEnd(shard.sessionEnd_);
+            book->AdvanceTime(shard.time_);
+        }
+        return *book;
+    }
+
+    // Returns false only if pinning was asked for and failed
+    bool Pin(std::size_t shardIndex)
+    {
+#ifdef __linux__
+        if(!config_.pinThreads_){
+            return true;
+        }
+        const int cpu = config_.firstCpu_ + static_cast<int>(shardIndex);
+        if(cpu < 0 || cpu >= CPU_SETSIZE){
+            return false;
+        }
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+        (void)shardIndex;
+        return true;
+#endif
+    }
+
+    void Apply(Shard& shard, const OrderMessage& message)
+    {
+        OrderRequest request;
+        if(!message.ToRequest(request)){
+            return;
+        }
+        if(request.type_ == RequestType::AdvanceTime){
+            shard.time_ = std::max(shard.time_, request.time_);
+            for(auto& book : shard.books_){
+                book.second->AdvanceTime(request.time_);
+            }
+            return;
+        }
+        if(request.type_ == RequestType::SetSessionEnd){
+            shard.sessionEnd_ = request.time_;
+            for(auto& book : shard.books_){
+                book.second->SetSessionEnd(request.time_);
+            }
+            return;
+        }
+        if(request.type_ == RequestType::ExpireGoodForDay){
+            for(auto& book : shard.books_){
+                book.second->ExpireGoodForDayOrders();
+            }
+            return;
+        }
+        Orderbook& orderbook = BookOf(shard, message.symbol_, config_.defaultBookConfig_);
+        shard.trades_.clear();
+        orderbook.ApplyBatch(&request, 1, shard.trades_);
+        if(!shard.trades_.empty() && onTrades_){
+            onTrades_(message.symbol_, shard.trades_);
+        }
+    }
+
+    void Run(Shard& shard, std::size_t shardIndex)
+    {
+        shard.pinned_ = Pin(shardIndex);
+        for(const auto& symbol : shard.pendingSymbols_){
+            BookOf(shard, symbol.first, symbol.second);
+        }
+        shard.trades_.reserve(1024);
+        shard.started_.store(true, std::memory_order_release);
+
+        while(true){
+            if(OrderMessage* message = shard.queue_.Front()){
+                Apply(shard, *message);
+                shard.queue_.Pop();
+                shard.processed_.store(shard.processed_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                continue;
+            }
+            if(!shard.running_.load(std::memory_order_acquire)){
+                if(shard.queue_.IsEmpty()){
+                    return;
+                }
+                continue;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    OrderbookManagerConfig config_;
+    TradeHandler onTrades_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    bool workersRunning_{ false };   // Producer only
+};
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Kernels for the ladder's wide scans: skipping runs of empty occupancy
+// words, and summing level quantities across a price range. x86 builds
+// carry AVX2 word scans next to the scalar ones and pick between them from
+// the running CPU, once per process; each PriceLevels copies the chosen
+// pointers when it is built. AArch64 always has NEON. The quantity sum is
+// scalar on every target. Build with -DORDERBOOK_SIMD=0 to force the
+// scalar word scans everywhere.
+#ifndef ORDERBOOK_SIMD
+#define ORDERBOOK_SIMD 1
+#endif
+
+#if ORDERBOOK_SIMD && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ORDERBOOK_SIMD_AVX2 1
+#else
+#define ORDERBOOK_SIMD_AVX2 0
+#endif
+
+#if ORDERBOOK_SIMD && defined(__aarch64__)
+#define ORDERBOOK_SIMD_NEON 1
+#else
+#define ORDERBOOK_SIMD_NEON 0
+#endif
+
+namespace detail
+{
+    // --- Scalar Kernels ---
+    // Index of the first non-zero word in words[0, count), or count
+    inline std::size_t FindFirstNonZeroWordScalar(const std::uint64_t* words, std::size_t count)
+    {
+        for(std::size_t i = 0; i < count; ++i){
+            if(words[i]){
+                return i;
+            }
+        }
+        return count;
+    }
+
+    // Index of the last non-zero word in words[0, count), or count
+    inline std::size_t FindLastNonZeroWordScalar(const std::uint64_t* words, std::size_t count)
+    {
+        for(std::size_t i = count; i-- > 0;){
+            if(words[i]){
+                return i;
+            }
+        }
+        return count;
+    }
+
+    // Sum of values[i * stride] for i in [0, count). There is no vector
+    // version: an AVX2 gather measured slower than these four independent
+    // accumulators, which already run at the rate the levels stream in.
+    inline std::int64_t SumStridedScalar(const std::int32_t* values, std::size_t stride, std::size_t count)
+    {
+        std::int64_t sums[4] = { 0, 0, 0, 0 };
+        std::size_t i = 0;
+        for(; i + 4 <= count; i += 4){
+            sums[0] += values[i * stride];
+            sums[1] += values[(i + 1) * stride];
+            sums[2] += values[(i + 2) * stride];
+            sums[3] += values[(i + 3) * stride];
+        }
+        for(; i < count; ++i){
+            sums[0] += values[i * stride];
+        }
+        return sums[0] + sums[1] + sums[2] + sums[3];
+    }
+
+#if ORDERBOOK_SIMD_AVX2
+    // --- AVX2 Kernels ---
+    // Compiled for AVX2 regardless of the build flags; only ever called
+    // after the CPU has reported support.
+    __attribute__((target("avx2")))
+    inline std::size_t FindFirstNonZeroWordAvx2(const std::uint64_t* words, std::size_t count)
+    {
+        std::size_t i = 0;
+        for(; i + 4 <= count; i += 4){
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+            if(!_mm256_testz_si256(block, block)){
+                break;
+            }
+        }
+        std::size_t found = FindFirstNonZeroWordScalar(words + i, count - i);
+        return i + found;
+    }
+
+    __attribute__((target("avx2")))
+    inline std::size_t FindLastNonZeroWordAvx2(const std::uint64_t* words, std::size_t count)
+    {
+        std::size_t end = count;
+        for(; end >= 4; end -= 4){
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + end - 4));
+            if(!_mm256_testz_si256(block, block)){
+                break;
+            }
+        }
+        std::size_t found = FindLastNonZeroWordScalar(words, end);
+        return found == end ? count : found;
+    }
+#endif
+
+#if ORDERBOOK_SIMD_NEON
+    // --- NEON Kernels ---
+    inline std::size_t FindFirstNonZeroWordNeon(const std::uint64_t* words, std::size_t count)
+    {
+        std::size_t i = 0;
+        for(; i + 4 <= count; i += 4){
+            uint64x2_t block = vorrq_u64(vld1q_u64(words + i), vld1q_u64(words + i + 2));
+            if(vmaxvq_u32(vreinterpretq_u32_u64(block)) != 0){
+                break;
+            }
+        }
+        std::size_t found = FindFirstNonZeroWordScalar(words + i, count - i);
+        return i + found;
+    }
+
+    inline std::size_t FindLastNonZeroWordNeon(const std::uint64_t* words, std::size_t count)
+    {
+        std::size_t end = count;
+        for(; end >= 4; end -= 4){
+            uint64x2_t block = vorrq_u64(vld1q_u64(words + end - 4), vld1q_u64(words + end - 2));
+            if(vmaxvq_u32(vreinterpretq_u32_u64(block)) != 0){
+                break;
+            }
+        }
+        std::size_t found = FindLastNonZeroWordScalar(words, end);
+        return found == end ? count : found;
+    }
+#endif
+
+    // --- Kernel Dispatch ---
+    // Hot callers keep their own copy rather than going through
+    // GetSimdKernels, whose function-local static is checked on every call
+    struct SimdKernels
+    {
+        std::size_t (*findFirstNonZeroWord_)(const std::uint64_t*, std::size_t);
+        std::size_t (*findLastNonZeroWord_)(const std::uint64_t*, std::size_t);
+        const char* name_;
+    };
+
+    inline SimdKernels SelectSimdKernels()
+    {
+#if ORDERBOOK_SIMD_AVX2
+        if(__builtin_cpu_supports("avx2")){
+            return { FindFirstNonZeroWordAvx2, FindLastNonZeroWordAvx2, "avx2" };
+        }
+#endif
+#if ORDERBOOK_SIMD_NEON
+        return { FindFirstNonZeroWordNeon, FindLastNonZeroWordNeon, "neon" };
+#else
+        return { FindFirstNonZeroWordScalar, FindLastNonZeroWordScalar, "scalar" };
+#endif
+    }
+
+    inline const SimdKernels& GetSimdKernels()
+    {
+        static const SimdKernels kernels = SelectSimdKernels();
+        return kernels;
+    }
+}
+
+inline std::size_t FindFirstNonZeroWord(const std::uint64_t* words, std::size_t count)
+{
+    return detail::GetSimdKernels().findFirstNonZeroWord_(words, count);
+}
+
+inline std::size_t FindLastNonZeroWord(const std::uint64_t* words, std::size_t count)
+{
+    return detail::GetSimdKernels().findLastNonZeroWord_(words, count);
+}
+
+inline std::int64_t SumStrided(const std::int32_t* values, std::size_t stride, std::size_t count)
+{
+    return detail::SumStridedScalar(values, stride, count);
+}
+
+// Which kernel set this process runs: "avx2", "neon" or "scalar"
+inline const char* GetSimdKernelName()
+{
+    return detail::GetSimdKernels().name_;
+}
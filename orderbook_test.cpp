@@ -0,0 +1,1716 @@
+#include "orderbook_manager.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+
+#include <unistd.h>
+
+// Randomised checks of the book: against a naive reference model across
+// the level and order index backends, and through the journal, snapshot,
+// auction, expiry, manager and async sink paths.
+//
+//   ./orderbook_test [--seed=N] [--iterations=N]
+//
+// Every test prints the step it first diverged at and the run exits
+// non-zero; the same seed reproduces the same flow.
+
+namespace
+{
+    struct TestOptions
+    {
+        std::uint64_t seed_{ 1 };
+        std::size_t iterations_{ 20000 };
+    };
+
+    int failures = 0;
+
+    bool Expect(bool condition, const char* test, const char* what, std::size_t step)
+    {
+        if(!condition){
+            ++failures;
+            std::fprintf(stderr, "FAIL %s: %s at step %zu\n", test, what, step);
+        }
+        return condition;
+    }
+
+    std::string TempPath(const char* name)
+    {
+        return "/tmp/orderbook_test_" + std::to_string(::getpid()) + "_" + name;
+    }
+
+    // --- ReferenceBook Class ---
+    // Price-time matching written as plainly as possible: one vector of
+    // resting orders in arrival order, scanned in full for every decision.
+    // Unowned orders without expiry only.
+    class ReferenceBook
+    {
+    public:
+        struct Fill
+        {
+            OrderId makerOrderId_;
+            OrderId takerOrderId_;
+            Price price_;
+            Quantity quantity_;
+        };
+
+        std::vector<Fill> Add(const Order& order)
+        {
+            std::vector<Fill> fills;
+            if(Find(order.GetOrderId()) != orders_.size()){
+                return fills;
+            }
+            Order incoming{ order };
+            bool market = incoming.GetOrderType() == OrderType::Market;
+            auto crosses = [&](const Order& resting){
+                if(resting.GetSide() == incoming.GetSide()){
+                    return false;
+                }
+                if(market){
+                    return true;
+                }
+                return incoming.GetSide() == Side::Buy ? resting.GetPrice() <= incoming.GetPrice() : resting.GetPrice() >= incoming.GetPrice();
+            };
+            Quantity crossing = 0;
+            for(const Order& resting : orders_){
+                if(crosses(resting)){
+                    crossing += resting.GetRemainingQuantity();
+                }
+            }
+            switch(incoming.GetOrderType())
+            {
+            case OrderType::FillandKill:
+            case OrderType::Market:
+                if(crossing == 0){
+                    return fills;
+                }
+                break;
+            case OrderType::FillOrKill:
+                if(crossing < incoming.GetRemainingQuantity()){
+                    return fills;
+                }
+                break;
+            case OrderType::PostOnly:
+                if(crossing > 0){
+                    return fills;
+                }
+                break;
+            case OrderType::GoodTillCancel:
+            case OrderType::GoodForDay:
+            case OrderType::GoodTillTime:
+                break;
+            }
+            while(!incoming.IsFilled()){
+                std::size_t best = orders_.size();
+                for(std::size_t i = 0; i < orders_.size(); ++i){
+                    if(!crosses(orders_[i])){
+                        continue;
+                    }
+                    if(best == orders_.size()
+                        || (incoming.GetSide() == Side::Buy ? orders_[i].GetPrice() < orders_[best].GetPrice()
+                                                           : orders_[i].GetPrice() > orders_[best].GetPrice())){
+                        best = i;
+                    }
+                }
+                if(best == orders_.size()){
+                    break;
+                }
+                Order& resting = orders_[best];
+                Quantity quantity = std::min(resting.GetRemainingQuantity(), incoming.GetRemainingQuantity());
+                resting.Fill(quantity);
+                incoming.Fill(quantity);
+                fills.push_back(Fill{ resting.GetOrderId(), incoming.GetOrderId(), resting.GetPrice(), quantity });
+                if(resting.IsFilled()){
+                    orders_.erase(orders_.begin() + static_cast<std::ptrdiff_t>(best));
+                }
+            }
+            OrderType type = incoming.GetOrderType();
+            if(!incoming.IsFilled() && (type == OrderType::GoodTillCancel || type == OrderType::GoodForDay || type == OrderType::PostOnly)){
+                orders_.push_back(incoming);
+            }
+            return fills;
+        }
+
+        void Cancel(OrderId orderId)
+        {
+            std::size_t index = Find(orderId);
+            if(index != orders_.size()){
+                orders_.erase(orders_.begin() + static_cast<std::ptrdiff_t>(index));
+            }
+        }
+
+        std::vector<Fill> Modify(const OrderModify& modify)
+        {
+            std::size_t index = Find(modify.GetOrderId());
+            if(index == orders_.size()){
+                return {};
+            }
+            Order& existing = orders_[index];
+            if(existing.GetSide() == modify.GetSide() && existing.GetPrice() == modify.GetPrice()
+                && modify.GetQuantity() > 0 && modify.GetQuantity() <= existing.GetRemainingQuantity()){
+                existing.ReduceQuantity(modify.GetQuantity());
+                return {};
+            }
+            OrderType type = existing.GetOrderType();
+            Cancel(modify.GetOrderId());
+            return Add(modify.ToOrder(type));
+        }
+
+        // The ids cancelled, best level first and in queue order within one
+        std::vector<OrderId> CancelRange(Side side, Price minPrice, Price maxPrice)
+        {
+            std::vector<Order> cancelled;
+            std::vector<Order> kept;
+            for(const Order& order : orders_){
+                bool inRange = order.GetSide() == side && order.GetPrice() >= minPrice && order.GetPrice() <= maxPrice;
+                (inRange ? cancelled : kept).push_back(order);
+            }
+            orders_.swap(kept);
+            std::stable_sort(cancelled.begin(), cancelled.end(), [side](const Order& left, const Order& right){
+                return side == Side::Buy ? left.GetPrice() > right.GetPrice() : left.GetPrice() < right.GetPrice();
+            });
+            std::vector<OrderId> ids;
+            for(const Order& order : cancelled){
+                ids.push_back(order.GetOrderId());
+            }
+            return ids;
+        }
+
+        void ExpireGoodForDay()
+        {
+            std::vector<Order> kept;
+            for(const Order& order : orders_){
+                if(order.GetOrderType() != OrderType::GoodForDay){
+                    kept.push_back(order);
+                }
+            }
+            orders_.swap(kept);
+        }
+
+        // Aggregate open quantity per price, best first
+        LevelInfos Levels(Side side) const
+        {
+            std::map<Price, LevelInfo> levels;
+            for(const Order& order : orders_){
+                if(order.GetSide() == side){
+                    LevelInfo& level = levels.emplace(order.GetPrice(), LevelInfo{ order.GetPrice(), 0, 0 }).first->second;
+                    level.quantity_ += order.GetRemainingQuantity();
+                    ++level.orderCount_;
+                }
+            }
+            LevelInfos infos;
+            for(const auto& level : levels){
+                infos.push_back(level.second);
+            }
+            if(side == Side::Buy){
+                std::reverse(infos.begin(), infos.end());
+            }
+            return infos;
+        }
+
+    private:
+        std::size_t Find(OrderId orderId) const
+        {
+            for(std::size_t i = 0; i < orders_.size(); ++i){
+                if(orders_[i].GetOrderId() == orderId){
+                    return i;
+                }
+            }
+            return orders_.size();
+        }
+
+        std::vector<Order> orders_;
+    };
+
+    // --- RecordingSink Class ---
+    // Writes every event as one line, so two books can be compared by string
+    class RecordingSink : public OrderbookEventSink
+    {
+    public:
+        void OnOrderAdded(const Order& order) override
+        {
+            out_ << "A ";
+            WriteOrder(order);
+            out_ << '\n';
+        }
+
+        void OnOrderCancelled(OrderId orderId) override { out_ << "C " << orderId << '\n'; }
+
+        void OnOrderModified(const Order& existingOrder, const OrderModify& orderModify) override
+        {
+            out_ << "M ";
+            WriteOrder(existingOrder);
+            out_ << " -> " << static_cast<int>(orderModify.GetSide()) << ' ' << orderModify.GetPrice() << ' '
+                 << orderModify.GetQuantity() << '\n';
+        }
+
+        void OnOrderRejected(OrderId orderId, RejectReason reason) override
+        {
+            out_ << "R " << orderId << ' ' << static_cast<int>(reason) << '\n';
+        }
+
+        void OnTrade(const Trade& trade) override
+        {
+            out_ << "T " << trade.GetMakerOrderId() << ' ' << trade.GetTakerOrderId() << ' ' << trade.GetPrice() << ' '
+                 << trade.GetQuantity() << ' ' << static_cast<int>(trade.GetAggressorSide()) << ' ' << trade.GetSequence() << '\n';
+        }
+
+        std::string Take()
+        {
+            std::string events = out_.str();
+            out_.str(std::string{});
+            return events;
+        }
+
+    private:
+        void WriteOrder(const Order& order)
+        {
+            out_ << order.GetOrderId() << ' ' << static_cast<int>(order.GetOrderType()) << ' ' << static_cast<int>(order.GetSide()) << ' '
+                 << order.GetPrice() << ' ' << order.GetInitialQuantity() << ' ' << order.GetRemainingQuantity() << ' ' << order.GetParticipant() << ' '
+                 << order.GetExpiry();
+        }
+
+        std::ostringstream out_;
+    };
+
+    // Every resting order in priority order, as text
+    std::string DescribeOrders(const Orderbook& orderbook)
+    {
+        std::ostringstream out;
+        orderbook.ForEachOrder([&out](const Order& order){
+            out << order.GetOrderId() << ' ' << static_cast<int>(order.GetSide()) << ' ' << order.GetPrice() << ' '
+                << order.GetInitialQuantity() << ' ' << order.GetRemainingQuantity() << ' ' << order.GetParticipant() << ' '
+                << static_cast<int>(order.GetOrderType()) << ' ' << order.GetExpiry() << '\n';
+        });
+        return out.str();
+    }
+
+    bool SameLevels(const LevelInfos& left, const LevelInfos& right)
+    {
+        if(left.size() != right.size()){
+            return false;
+        }
+        for(std::size_t i = 0; i < left.size(); ++i){
+            if(left[i].price_ != right[i].price_ || left[i].quantity_ != right[i].quantity_ || left[i].orderCount_ != right[i].orderCount_){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool SameDepth(const Orderbook& left, const Orderbook& right)
+    {
+        OrderbookLevelInfos leftInfos = left.GetOrderInfos();
+        OrderbookLevelInfos rightInfos = right.GetOrderInfos();
+        return SameLevels(leftInfos.GetBids(), rightInfos.GetBids()) && SameLevels(leftInfos.GetAsks(), rightInfos.GetAsks());
+    }
+
+    // Aggregates, participant counters and the digest recomputed from the orders
+    bool ConsistentWithOrders(const Orderbook& orderbook)
+    {
+        std::map<std::pair<int, Price>, LevelInfo> levels;
+        std::map<ParticipantId, std::pair<std::size_t, std::int64_t>> participants;
+        orderbook.ForEachOrder([&](const Order& order){
+            LevelInfo& level = levels.emplace(std::make_pair(static_cast<int>(order.GetSide()), order.GetPrice()),
+                                              LevelInfo{ order.GetPrice(), 0, 0 }).first->second;
+            level.quantity_ += order.GetRemainingQuantity();
+            ++level.orderCount_;
+            if(order.GetParticipant() != NoParticipant){
+                auto& counters = participants[order.GetParticipant()];
+                ++counters.first;
+                counters.second += Notional(order.GetPrice(), order.GetRemainingQuantity());
+            }
+        });
+        bool consistent = true;
+        auto checkSide = [&](Side side){
+            orderbook.ForEachLevel(side, [&](const LevelInfo& info){
+                auto found = levels.find(std::make_pair(static_cast<int>(side), info.price_));
+                consistent = consistent && found != levels.end() && found->second.quantity_ == info.quantity_
+                    && found->second.orderCount_ == info.orderCount_;
+            });
+        };
+        checkSide(Side::Buy);
+        checkSide(Side::Sell);
+        for(ParticipantId participant = 1; participant <= 4; ++participant){
+            auto counters = participants[participant];
+            consistent = consistent && orderbook.GetParticipantOrderCount(participant) == counters.first
+                && orderbook.GetParticipantOpenNotional(participant) == counters.second;
+        }
+        return consistent && orderbook.GetDigest() == orderbook.ComputeDigest();
+    }
+
+    // Applies the L2 deltas of the last call to a shadow depth
+    void ApplyLevelUpdates(const Orderbook& orderbook, std::map<std::pair<int, Price>, LevelInfo>& shadow)
+    {
+        for(const LevelUpdate& update : orderbook.GetLevelUpdates()){
+            auto key = std::make_pair(static_cast<int>(update.side_), update.price_);
+            if(update.quantity_ == 0){
+                shadow.erase(key);
+            }
+            else{
+                shadow[key] = LevelInfo{ update.price_, update.quantity_, update.orderCount_ };
+            }
+        }
+    }
+
+    bool MatchesShadow(const Orderbook& orderbook, const std::map<std::pair<int, Price>, LevelInfo>& shadow)
+    {
+        std::size_t levels = 0;
+        bool matches = true;
+        for(Side side : { Side::Buy, Side::Sell }){
+            orderbook.ForEachLevel(side, [&](const LevelInfo& info){
+                auto found = shadow.find(std::make_pair(static_cast<int>(side), info.price_));
+                matches = matches && found != shadow.end() && found->second.quantity_ == info.quantity_
+                    && found->second.orderCount_ == info.orderCount_;
+                ++levels;
+            });
+        }
+        return matches && levels == shadow.size();
+    }
+
+    // --- Flow Struct ---
+    // Random order flow for the tests below; ids count up from 1 so the
+    // direct order index can hold them
+    struct Flow
+    {
+        explicit Flow(std::uint64_t seed)
+            : rng_{ seed }
+        {}
+
+        std::uint64_t Draw(std::uint64_t bound) { return rng_() % bound; }
+        bool Chance(unsigned percent) { return Draw(100) < percent; }
+        Side DrawSide() { return Chance(50) ? Side::Buy : Side::Sell; }
+
+        // Mostly near the touch, sometimes outside a 64-tick ladder band
+        Price DrawPrice(Side side)
+        {
+            Price distance = static_cast<Price>(Chance(5) ? Draw(120) : Draw(12));
+            Price price = side == Side::Buy ? 1000 - distance : 1000 + distance;
+            return price + static_cast<Price>(Draw(5)) - 2;
+        }
+
+        Quantity DrawQuantity() { return static_cast<Quantity>(1 + Draw(40)); }
+        OrderId DrawKnownId() { return static_cast<OrderId>(1 + Draw(static_cast<std::uint64_t>(nextOrderId_))); }
+
+        std::mt19937_64 rng_;
+        OrderId nextOrderId_{ 1 };
+    };
+
+    // GoodTillTime only when the caller gives its orders an expiry
+    OrderType DrawOrderType(Flow& flow, bool withExpiry = false)
+    {
+        static const OrderType types[] = { OrderType::GoodTillCancel, OrderType::GoodTillCancel, OrderType::GoodTillCancel,
+                                           OrderType::FillandKill, OrderType::Market, OrderType::FillOrKill,
+                                           OrderType::PostOnly, OrderType::GoodForDay, OrderType::GoodTillTime };
+        return types[flow.Draw(withExpiry ? 9 : 8)];
+    }
+
+    bool SameFill(const Trade& trade, OrderId bidOrderId, OrderId askOrderId, Quantity quantity)
+    {
+        return trade.GetBidTrade().orderId_ == bidOrderId && trade.GetAskTrade().orderId_ == askOrderId
+            && trade.GetBidTrade().quantity_ == quantity && trade.GetAskTrade().quantity_ == quantity;
+    }
+
+    // --- Tests ---
+    // The map and ladder level backends, each with the hashed and the direct
+    // order index, against the reference. The direct index starts far too
+    // small for the flow so its ring grows under resting orders. Odd books
+    // take their requests through ApplyBatch. Every book's L2 updates must
+    // keep a shadow depth in step with it, and mass cancels must report
+    // their orders best level first on every backend.
+    void TestAgainstReference(const TestOptions& options)
+    {
+        const char* test = "reference";
+        for(int backend = 0; backend < 4; ++backend){
+            OrderbookConfig config;
+            config.referencePrice_ = 1000;
+            config.ladderTicks_ = backend % 2 ? 64 : 0;
+            config.orderIndexMode_ = backend / 2 ? OrderIndexMode::Direct : OrderIndexMode::Hashed;
+            config.baseOrderId_ = 1;
+            config.orderCapacity_ = backend / 2 ? 16 : 1 << 16;
+            config.levelUpdates_ = true;
+            Orderbook orderbook{ config };
+            RecordingSink sink;
+            orderbook.SetEventSink(&sink);
+            ReferenceBook reference;
+            std::map<std::pair<int, Price>, LevelInfo> shadow;
+            Flow flow{ options.seed_ + static_cast<std::uint64_t>(backend) };
+            auto apply = [&](const OrderRequest& request, Trades& trades){
+                if(backend % 2){
+                    orderbook.ApplyBatch(&request, 1, trades);
+                }
+                else if(request.type_ == RequestType::Add){
+                    orderbook.AddOrder(request.ToOrder(), trades);
+                }
+                else if(request.type_ == RequestType::Cancel){
+                    orderbook.CancelOrder(request.orderId_);
+                }
+                else if(request.type_ == RequestType::CancelRange){
+                    orderbook.CancelRange(request.side_, request.price_, request.maxPrice_);
+                }
+                else{
+                    orderbook.ModifyOrder(request.ToOrderModify(), trades);
+                }
+            };
+            for(std::size_t step = 0; step < options.iterations_; ++step){
+                std::vector<ReferenceBook::Fill> expected;
+                Trades trades;
+                sink.Take();
+                unsigned kind = static_cast<unsigned>(flow.Draw(100));
+                if(kind < 1){
+                    Side side = flow.DrawSide();
+                    Price low = flow.DrawPrice(side);
+                    OrderRequest request = flow.Chance(20) ? OrderRequest::CancelAll(side)
+                                                           : OrderRequest::CancelRange(side, low, low + static_cast<Price>(flow.Draw(4)));
+                    std::string expectedCancels;
+                    for(OrderId orderId : reference.CancelRange(side, request.price_, request.maxPrice_)){
+                        expectedCancels += "C " + std::to_string(orderId) + "\n";
+                    }
+                    apply(request, trades);
+                    if(!Expect(sink.Take() == expectedCancels, test, "mass cancel order differs from the reference", step)){
+                        return;
+                    }
+                }
+                else if(kind < 55){
+                    Side side = flow.DrawSide();
+                    Order order{ DrawOrderType(flow), flow.nextOrderId_++, side, flow.DrawPrice(side), flow.DrawQuantity() };
+                    expected = reference.Add(order);
+                    apply(OrderRequest::Add(order), trades);
+                }
+                else if(kind < 80){
+                    OrderId orderId = flow.DrawKnownId();
+                    reference.Cancel(orderId);
+                    apply(OrderRequest::Cancel(orderId), trades);
+                }
+                else if(kind < 99){
+                    Side side = flow.DrawSide();
+                    OrderModify modify{ flow.DrawKnownId(), side, flow.DrawPrice(side), flow.DrawQuantity() };
+                    expected = reference.Modify(modify);
+                    apply(OrderRequest::Modify(modify), trades);
+                }
+                else{
+                    reference.ExpireGoodForDay();
+                    orderbook.ExpireGoodForDayOrders();
+                }
+                bool sameTrades = trades.size() == expected.size();
+                for(std::size_t i = 0; sameTrades && i < trades.size(); ++i){
+                    sameTrades = trades[i].GetMakerOrderId() == expected[i].makerOrderId_ && trades[i].GetTakerOrderId() == expected[i].takerOrderId_
+                        && trades[i].GetPrice() == expected[i].price_ && trades[i].GetQuantity() == expected[i].quantity_;
+                }
+                // Level quantities and order counts are kept incrementally,
+                // the reference adds them up from its orders
+                OrderbookLevelInfos infos = orderbook.GetOrderInfos();
+                ApplyLevelUpdates(orderbook, shadow);
+                if(!Expect(sameTrades, test, "trades differ from the reference", step)
+                    || !Expect(SameLevels(infos.GetBids(), reference.Levels(Side::Buy)) && SameLevels(infos.GetAsks(), reference.Levels(Side::Sell)),
+                               test, "depth differs from the reference", step)
+                    || !Expect(MatchesShadow(orderbook, shadow), test, "L2 updates differ from the depth", step)){
+                    return;
+                }
+            }
+        }
+    }
+
+    // Full flow, owned orders, risk limits, auctions and expiry included,
+    // through the map and ladder level backends and the hashed and direct
+    // order indexes; all four must report the same events and hold the
+    // same orders with the same digest
+    void TestBackendsAgree(const TestOptions& options)
+    {
+        const char* test = "backends";
+        const std::size_t BookCount = 4;
+        std::vector<std::unique_ptr<Orderbook>> books;
+        std::vector<std::unique_ptr<RecordingSink>> sinks;
+        for(std::size_t i = 0; i < BookCount; ++i){
+            OrderbookConfig config;
+            config.referencePrice_ = 1000;
+            config.ladderTicks_ = i % 2 ? 64 : 0;
+            config.orderIndexMode_ = i / 2 ? OrderIndexMode::Direct : OrderIndexMode::Hashed;
+            config.baseOrderId_ = 1;
+            config.orderCapacity_ = 256;
+            config.levelUpdates_ = true;
+            config.digest_ = true;
+            config.expiryTick_ = 1000;
+            config.riskLimits_.maxOpenOrders_ = 60;
+            config.riskLimits_.maxOpenNotional_ = 60 * 1000 * 25;
+            config.riskLimits_.maxMessages_ = 200;
+            config.riskLimits_.messageWindow_ = 100000;
+            books.push_back(std::make_unique<Orderbook>(config));
+            sinks.push_back(std::make_unique<RecordingSink>());
+            books.back()->SetEventSink(sinks.back().get());
+        }
+        std::map<std::pair<int, Price>, LevelInfo> shadow;
+
+        Flow flow{ options.seed_ * 31 + 7 };
+        Timestamp now = 0;
+        for(std::size_t step = 0; step < options.iterations_; ++step){
+            std::vector<Trades> trades(BookCount);
+            unsigned kind = static_cast<unsigned>(flow.Draw(1000));
+            auto each = [&](auto&& apply){
+                for(std::size_t i = 0; i < BookCount; ++i){
+                    apply(*books[i], trades[i]);
+                }
+            };
+            if(kind < 450){
+                Side side = flow.DrawSide();
+                OrderType type = DrawOrderType(flow, true);
+                ParticipantId participant = static_cast<ParticipantId>(flow.Draw(5));
+                Timestamp expiry = now + flow.Draw(flow.Chance(10) ? 2000000 : 50000);
+                Order order{ type, flow.nextOrderId_++, side, flow.DrawPrice(side), flow.DrawQuantity(), participant, expiry };
+                each([&](Orderbook& book, Trades& out){ book.AddOrder(order, out); });
+            }
+            else if(kind < 700){
+                OrderId orderId = flow.DrawKnownId();
+                each([&](Orderbook& book, Trades&){ book.CancelOrder(orderId); });
+            }
+            else if(kind < 900){
+                Side side = flow.DrawSide();
+                OrderModify modify{ flow.DrawKnownId(), side, flow.DrawPrice(side), flow.DrawQuantity() };
+                each([&](Orderbook& book, Trades& out){ book.ModifyOrder(modify, out); });
+            }
+            else if(kind < 960){
+                now += flow.Draw(flow.Chance(5) ? 100000 : 3000);
+                each([&](Orderbook& book, Trades&){ book.AdvanceTime(now); });
+            }
+            else if(kind < 970){
+                Side side = flow.DrawSide();
+                Price low = flow.DrawPrice(side);
+                Price high = low + static_cast<Price>(flow.Draw(6));
+                OrderRequest request = OrderRequest::CancelRange(side, low, high);
+                each([&](Orderbook& book, Trades& out){ book.ApplyBatch(&request, 1, out); });
+            }
+            else if(kind < 975){
+                ParticipantId participant = static_cast<ParticipantId>(1 + flow.Draw(4));
+                OrderRequest request = OrderRequest::CancelParticipant(participant);
+                each([&](Orderbook& book, Trades& out){ book.ApplyBatch(&request, 1, out); });
+            }
+            else if(kind < 980){
+                Timestamp end = flow.Chance(30) ? 0 : now + flow.Draw(60000);
+                each([&](Orderbook& book, Trades&){ book.SetSessionEnd(end); });
+            }
+            else if(kind < 983){
+                each([&](Orderbook& book, Trades&){ book.ExpireGoodForDayOrders(); });
+            }
+            else if(kind < 986){
+                ParticipantId participant = static_cast<ParticipantId>(1 + flow.Draw(4));
+                RiskLimits limits;
+                limits.maxOpenOrders_ = static_cast<std::uint32_t>(flow.Draw(80));
+                limits.maxOpenNotional_ = static_cast<std::int64_t>(flow.Draw(3000000));
+                each([&](Orderbook& book, Trades&){ book.SetRiskLimits(participant, limits); });
+            }
+            else if(kind < 993){
+                // Now and then the transition that does not apply, which a
+                // batch drops
+                Price reference = 1000 + static_cast<Price>(flow.Draw(5)) - 2;
+                bool end = books[0]->IsInAuction() != flow.Chance(10);
+                OrderRequest request = end ? OrderRequest::EndAuction() : OrderRequest::BeginAuction(reference);
+                each([&](Orderbook& book, Trades& out){ book.ApplyBatch(&request, 1, out); });
+            }
+            else{
+                Side side = flow.DrawSide();
+                each([&](Orderbook& book, Trades&){ book.CancelAll(side); });
+            }
+
+            std::string events = sinks[0]->Take();
+            std::string orders = DescribeOrders(*books[0]);
+            bool agree = true;
+            for(std::size_t i = 1; i < BookCount; ++i){
+                agree = agree && sinks[i]->Take() == events && DescribeOrders(*books[i]) == orders
+                    && books[i]->GetDigest() == books[0]->GetDigest() && trades[i].size() == trades[0].size();
+            }
+            ApplyLevelUpdates(*books[0], shadow);
+            bool crossed = false;
+            if(!books[0]->IsInAuction()){
+                OrderbookLevelInfos top = books[0]->GetOrderInfos(1);
+                crossed = !top.GetBids().empty() && !top.GetAsks().empty() && top.GetBids()[0].price_ >= top.GetAsks()[0].price_;
+            }
+            if(!Expect(agree, test, "backends disagree", step)
+                || !Expect(ConsistentWithOrders(*books[0]), test, "aggregates, counters or digest drifted from the orders", step)
+                || !Expect(MatchesShadow(*books[0], shadow), test, "level updates do not rebuild the depth", step)
+                || !Expect(!crossed, test, "book left crossed outside an auction", step)){
+                return;
+            }
+        }
+    }
+
+    // Brute force: the most volume any single price could execute
+    std::int64_t MaxUncrossVolume(const Orderbook& orderbook)
+    {
+        std::map<Price, std::pair<std::int64_t, std::int64_t>> levels;
+        orderbook.ForEachLevel(Side::Buy, [&](const LevelInfo& info){ levels[info.price_].first += info.quantity_; });
+        orderbook.ForEachLevel(Side::Sell, [&](const LevelInfo& info){ levels[info.price_].second += info.quantity_; });
+        std::int64_t best = 0;
+        for(const auto& candidate : levels){
+            std::int64_t bids = 0;
+            std::int64_t asks = 0;
+            for(const auto& level : levels){
+                bids += level.first >= candidate.first ? level.second.first : 0;
+                asks += level.first <= candidate.first ? level.second.second : 0;
+            }
+            best = std::max(best, std::min(bids, asks));
+        }
+        return best;
+    }
+
+    void TestAuction(const TestOptions& options)
+    {
+        const char* test = "auction";
+        Flow flow{ options.seed_ * 17 + 3 };
+        for(std::size_t round = 0; round < options.iterations_ / 100; ++round){
+            OrderbookConfig config;
+            config.referencePrice_ = 1000;
+            config.ladderTicks_ = round % 2 ? 64 : 0;
+            config.digest_ = true;
+            Orderbook orderbook{ config };
+            orderbook.BeginAuction(1000);
+            std::size_t orderCount = 10 + static_cast<std::size_t>(flow.Draw(100));
+            for(std::size_t i = 0; i < orderCount; ++i){
+                Side side = flow.DrawSide();
+                // Spread both sides over the same prices so the book crosses
+                Price price = 990 + static_cast<Price>(flow.Draw(21));
+                orderbook.AddOrder(Order{ OrderType::GoodTillCancel, static_cast<OrderId>(i + 1), side, price, flow.DrawQuantity() });
+                if(flow.Chance(10)){
+                    orderbook.CancelOrder(static_cast<OrderId>(1 + flow.Draw(i + 1)));
+                }
+            }
+            IndicativeUncross uncross = orderbook.GetIndicativeUncross();
+            if(!Expect(uncross.volume_ == MaxUncrossVolume(orderbook), test, "indicative volume is not the maximum", round)){
+                return;
+            }
+            Trades trades = orderbook.EndAuction();
+            std::int64_t traded = 0;
+            bool atPrice = true;
+            for(const Trade& trade : trades){
+                traded += trade.GetQuantity();
+                atPrice = atPrice && trade.GetPrice() == uncross.price_;
+            }
+            OrderbookLevelInfos top = orderbook.GetOrderInfos(1);
+            bool crossed = !top.GetBids().empty() && !top.GetAsks().empty() && top.GetBids()[0].price_ >= top.GetAsks()[0].price_;
+            if(!Expect(traded == uncross.volume_ && atPrice, test, "uncross did not trade the indicative volume at its price", round)
+                || !Expect(!crossed, test, "book still crossed after the uncross", round)
+                || !Expect(orderbook.GetDigest() == orderbook.ComputeDigest(), test, "digest drifted", round)){
+                return;
+            }
+        }
+    }
+
+    // Every GoodTillTime order leaves at the first advance past its expiry
+    // tick, never before
+    void TestExpiry(const TestOptions& options)
+    {
+        const char* test = "expiry";
+        const Timestamp Tick = 1000;
+        OrderbookConfig config;
+        config.expiryTick_ = Tick;
+        Orderbook orderbook{ config };
+        std::map<OrderId, Timestamp> live;
+        Flow flow{ options.seed_ * 13 + 5 };
+        Timestamp now = 0;
+        for(std::size_t step = 0; step < options.iterations_; ++step){
+            unsigned kind = static_cast<unsigned>(flow.Draw(100));
+            if(kind < 50){
+                Side side = flow.DrawSide();
+                // Spans from under a tick to far beyond the lowest wheel levels
+                std::uint64_t scale = std::uint64_t{ 1 } << (4 + flow.Draw(36));
+                Timestamp expiry = now + 1 + flow.Draw(scale);
+                Price price = side == Side::Buy ? 900 - static_cast<Price>(flow.Draw(10)) : 1100 + static_cast<Price>(flow.Draw(10));
+                OrderId orderId = flow.nextOrderId_++;
+                orderbook.AddOrder(Order{ OrderType::GoodTillTime, orderId, side, price, flow.DrawQuantity(), NoParticipant, expiry });
+                live[orderId] = expiry;
+            }
+            else if(kind < 60){
+                OrderId orderId = flow.DrawKnownId();
+                orderbook.CancelOrder(orderId);
+                live.erase(orderId);
+            }
+            else{
+                now += flow.Chance(2) ? flow.Draw(std::uint64_t{ 1 } << 40) : flow.Draw(3 * Tick);
+                std::size_t due = 0;
+                for(const auto& order : live){
+                    due += (order.second + Tick - 1) / Tick <= now / Tick ? 1 : 0;
+                }
+                std::size_t expired = orderbook.AdvanceTime(now);
+                bool early = false;
+                orderbook.ForEachOrder([&](const Order& order){
+                    early = early || (order.GetExpiry() + Tick - 1) / Tick <= now / Tick;
+                });
+                for(auto it = live.begin(); it != live.end();){
+                    it = (it->second + Tick - 1) / Tick <= now / Tick ? live.erase(it) : std::next(it);
+                }
+                if(!Expect(expired == due && !early && orderbook.Size() == live.size(), test, "orders expired early, late or not at all", step)){
+                    return;
+                }
+            }
+        }
+
+        // An expiry that has already passed when the order is restored, and
+        // a session end the book time has already reached, both take effect
+        // at the very next advance, even one within the same tick
+        Orderbook restored{ config };
+        restored.AdvanceTime(10 * Tick + 1);
+        restored.RestoreOrder(Order{ OrderType::GoodTillTime, 1, Side::Buy, 100, 10, NoParticipant, 10 * Tick });
+        restored.AddOrder(Order{ OrderType::GoodForDay, 2, Side::Buy, 99, 10 });
+        restored.AddOrder(Order{ OrderType::GoodForDay, 3, Side::Sell, 101, 10 });
+        bool overdue = restored.AdvanceTime(10 * Tick + 1) == 1 && restored.Size() == 2;
+        restored.SetSessionEnd(10 * Tick);
+        bool dayEnded = restored.GetScheduledExpiryCount() == 2 && restored.AdvanceTime(10 * Tick + 2) == 2 && restored.Size() == 0;
+        Expect(overdue && dayEnded, test, "overdue or end-of-day orders waited for the next tick", 0);
+    }
+
+    // A snapshot captured while the book is crossed in an auction must
+    // come back in the auction, crossed, so that the journal tail rests a
+    // crossing order and the journaled EndAuction uncrosses as it did live
+    void TestAuctionRecovery(const TestOptions&)
+    {
+        const char* test = "auction recovery";
+        std::string journalPath = TempPath("auction_journal");
+        std::string snapshotPath = TempPath("auction_snapshot");
+        OrderbookConfig config;
+        config.digest_ = true;
+        Orderbook live{ config };
+        live.BeginAuction(100);
+        live.AddOrder(Order{ OrderType::GoodTillCancel, 1, Side::Buy, 102, 10 });
+        live.AddOrder(Order{ OrderType::GoodTillCancel, 2, Side::Sell, 99, 12 });
+        OrderbookSnapshot::Capture(live, 0).Write(snapshotPath);
+        {
+            OrderbookJournal journal{ journalPath };
+            OrderbookEventLoop loop{ live, 16 };
+            loop.SetJournal(&journal);
+            loop.Post(OrderMessage::FromRequest(0, OrderRequest::Add(Order{ OrderType::GoodTillCancel, 3, Side::Buy, 101, 5 })));
+            loop.Post(OrderMessage::FromRequest(0, OrderRequest::EndAuction()));
+            while(loop.Poll()){
+            }
+        }
+        Orderbook recovered{ config };
+        OrderbookSnapshot::Load(snapshotPath).Restore(recovered);
+        bool restored = recovered.IsInAuction() && recovered.GetAuctionReferencePrice() == 100 && recovered.Size() == 2;
+        ReplayJournal(journalPath, recovered);
+        ::unlink(journalPath.c_str());
+        ::unlink(snapshotPath.c_str());
+        Expect(restored && !recovered.IsInAuction() && live.GetTradeSequence() == 2 && recovered.GetTradeSequence() == live.GetTradeSequence()
+               && recovered.GetDigest() == live.GetDigest()
+               && DescribeOrders(recovered) == DescribeOrders(live), test, "book recovered from a mid-auction snapshot differs", 0);
+    }
+
+    // A book fed through an event loop with a journal and periodic
+    // snapshots must come back identical from the last snapshot plus the
+    // journal tail, and from the journal alone
+    void TestRecovery(const TestOptions& options)
+    {
+        const char* test = "recovery";
+        std::string journalPath = TempPath("journal");
+        std::string snapshotPath = TempPath("snapshot");
+        OrderbookConfig config;
+        config.referencePrice_ = 1000;
+        config.ladderTicks_ = 64;
+        config.digest_ = true;
+        // Tight enough that owned flow is regularly risk-rejected, which
+        // replay has to reproduce
+        config.riskLimits_.maxOpenOrders_ = 8;
+        Orderbook live{ config };
+        {
+            OrderbookJournal journal{ journalPath };
+            OrderbookEventLoop loop{ live, 1024 };
+            loop.SetJournal(&journal);
+            bool captured = false;
+            OrderbookSnapshot last = OrderbookSnapshot::Capture(live, 0);
+            loop.SetSnapshotPolicy(options.iterations_ / 7 + 1, [&](OrderbookSnapshot&& snapshot){
+                last = std::move(snapshot);
+                captured = true;
+            });
+            Flow flow{ options.seed_ * 7 + 1 };
+            Timestamp now = 0;
+            for(std::size_t step = 0; step < options.iterations_; ++step){
+                Side side = flow.DrawSide();
+                OrderRequest request;
+                unsigned kind = static_cast<unsigned>(flow.Draw(100));
+                if(kind < 3){
+                    now += flow.Draw(20000);
+                    request = OrderRequest::AdvanceTime(now);
+                }
+                else if(kind < 4){
+                    Price low = flow.DrawPrice(side);
+                    request = flow.Chance(20) ? OrderRequest::CancelAll(side) : OrderRequest::CancelRange(side, low, low + static_cast<Price>(flow.Draw(4)));
+                }
+                else if(kind < 5){
+                    request = OrderRequest::CancelParticipant(static_cast<ParticipantId>(1 + flow.Draw(3)));
+                }
+                else if(kind < 6){
+                    request = live.IsInAuction() ? OrderRequest::EndAuction() : OrderRequest::BeginAuction(1000);
+                }
+                else if(kind < 55){
+                    ParticipantId participant = static_cast<ParticipantId>(flow.Draw(4));
+                    request = OrderRequest::Add(Order{ DrawOrderType(flow, true), flow.nextOrderId_++, side, flow.DrawPrice(side), flow.DrawQuantity(),
+                                                       participant, now + 1 + flow.Draw(50000) });
+                }
+                else if(kind < 80){
+                    request = OrderRequest::Cancel(flow.DrawKnownId());
+                }
+                else{
+                    request = OrderRequest::Modify(OrderModify{ flow.DrawKnownId(), side, flow.DrawPrice(side), flow.DrawQuantity() });
+                }
+                loop.Post(OrderMessage::FromRequest(0, request));
+                while(loop.Poll()){
+                }
+            }
+            journal.Flush();
+            if(!Expect(captured, test, "no snapshot was taken", 0)){
+                return;
+            }
+            last.Write(snapshotPath);
+        }
+
+        Orderbook fromSnapshot{ config };
+        RecoverOrderbook(fromSnapshot, snapshotPath, { journalPath });
+        Orderbook fromJournal{ config };
+        RecoverOrderbook(fromJournal, std::string{}, { journalPath });
+        ::unlink(journalPath.c_str());
+        ::unlink(snapshotPath.c_str());
+        for(const Orderbook* recovered : { &fromSnapshot, &fromJournal }){
+            bool same = recovered->GetDigest() == live.GetDigest() && DescribeOrders(*recovered) == DescribeOrders(live)
+                && SameDepth(*recovered, live) && recovered->GetTradeSequence() == live.GetTradeSequence()
+                && recovered->GetTime() == live.GetTime() && recovered->GetScheduledExpiryCount() == live.GetScheduledExpiryCount()
+                && recovered->IsInAuction() == live.IsInAuction();
+            for(ParticipantId participant = 1; participant < 4; ++participant){
+                same = same && recovered->GetParticipantOrderCount(participant) == live.GetParticipantOrderCount(participant);
+            }
+            if(!Expect(same, test, "recovered book differs", 0)){
+                return;
+            }
+        }
+    }
+
+    // A participant's orders are chained in arrival order on the live book
+    // and in snapshot order on a restored one; dropping its session must
+    // still cancel them in the same order on both
+    void TestParticipantRestore(const TestOptions& options)
+    {
+        const char* test = "session cancels";
+        Orderbook live;
+        Flow flow{ options.seed_ * 17 + 5 };
+        for(std::size_t step = 0; step < 300; ++step){
+            Side side = flow.DrawSide();
+            // Passive prices only, so every order rests
+            Price price = side == Side::Buy ? 990 - static_cast<Price>(flow.Draw(30)) : 1010 + static_cast<Price>(flow.Draw(30));
+            live.AddOrder(Order{ OrderType::GoodTillCancel, flow.nextOrderId_++, side, price, flow.DrawQuantity(),
+                                 static_cast<ParticipantId>(1 + flow.Draw(3)) });
+        }
+        Orderbook restored;
+        OrderbookSnapshot::Capture(live, 0).Restore(restored);
+        RecordingSink liveEvents;
+        RecordingSink restoredEvents;
+        live.SetEventSink(&liveEvents);
+        restored.SetEventSink(&restoredEvents);
+        for(ParticipantId participant = 1; participant < 4; ++participant){
+            live.CancelParticipantOrders(participant);
+            restored.CancelParticipantOrders(participant);
+            std::string cancels = liveEvents.Take();
+            if(!Expect(!cancels.empty() && restoredEvents.Take() == cancels, test, "participant cancels differ after a restore", participant)){
+                return;
+            }
+        }
+    }
+
+    // A snapshot header whose order count would overflow the size check
+    // is refused rather than read past the end of the file
+    void TestSnapshotHeader(const TestOptions&)
+    {
+        const char* test = "snapshot header";
+        std::string snapshotPath = TempPath("header");
+        Orderbook orderbook;
+        OrderbookSnapshot::Capture(orderbook, 0).Write(snapshotPath);
+        // Order count of 2^61: times 24 bytes a record it wraps to zero. It
+        // sits after the magic, version, record size and both sequences.
+        const std::uint64_t orderCount = std::uint64_t{ 1 } << 61;
+        FILE* file = std::fopen(snapshotPath.c_str(), "r+b");
+        bool patched = file && std::fseek(file, 32, SEEK_SET) == 0 && std::fwrite(&orderCount, sizeof(orderCount), 1, file) == 1;
+        if(file){
+            std::fclose(file);
+        }
+        bool refused = false;
+        try{
+            OrderbookSnapshot::Load(snapshotPath);
+        }
+        catch(const std::runtime_error&){
+            refused = true;
+        }
+        ::unlink(snapshotPath.c_str());
+        Expect(patched && refused, test, "overflowing order count accepted", 0);
+    }
+
+    // Flow for several symbols, some of them far apart, through a
+    // three-shard manager must leave each book as a single-threaded book
+    // fed the same symbol's flow and time, and report the same trades
+    void TestManager(const TestOptions& options)
+    {
+        const char* test = "manager";
+        const SymbolId symbols[] = { 0, 1, 2, 5, 7, 4000000000u, std::numeric_limits<SymbolId>::max() };
+        const std::size_t SymbolCount = sizeof(symbols) / sizeof(symbols[0]);
+        OrderbookManagerConfig config;
+        config.shardCount_ = 3;
+        config.queueCapacity_ = 256;
+        OrderbookConfig ladderConfig = config.defaultBookConfig_;
+        ladderConfig.referencePrice_ = 1000;
+        ladderConfig.ladderTicks_ = 64;
+
+        std::mutex tradesMutex;
+        std::map<SymbolId, std::size_t> tradedBySymbol;
+        OrderbookManager manager{ config, [&](SymbolId symbol, const Trades& trades){
+            std::lock_guard<std::mutex> lock{ tradesMutex };
+            tradedBySymbol[symbol] += trades.size();
+        } };
+        manager.RegisterSymbol(symbols[1], ladderConfig);
+        std::vector<std::unique_ptr<Orderbook>> expected;
+        std::map<SymbolId, std::size_t> expectedTrades;
+        for(std::size_t i = 0; i < SymbolCount; ++i){
+            expected.push_back(std::make_unique<Orderbook>(i == 1 ? ladderConfig : config.defaultBookConfig_));
+        }
+        manager.Start();
+
+        Flow flow{ options.seed_ * 11 + 9 };
+        Timestamp now = 0;
+        for(std::size_t step = 0; step < options.iterations_; ++step){
+            if(flow.Chance(2)){
+                now += flow.Draw(10000000);
+                manager.AdvanceTime(now);
+                for(auto& book : expected){
+                    book->AdvanceTime(now);
+                }
+                continue;
+            }
+            std::size_t symbolIndex = static_cast<std::size_t>(flow.Draw(SymbolCount));
+            Side side = flow.DrawSide();
+            OrderRequest request;
+            unsigned kind = static_cast<unsigned>(flow.Draw(100));
+            if(kind < 55){
+                OrderType type = flow.Chance(15) ? OrderType::FillandKill : flow.Chance(20) ? OrderType::GoodTillTime : OrderType::GoodTillCancel;
+                // Some expiries have passed already, which only a book that
+                // kept up with the time rejects
+                Timestamp expiry = now + flow.Draw(20000000) - std::min<Timestamp>(now, 10000000);
+                request = OrderRequest::Add(Order{ type, flow.nextOrderId_++, side, flow.DrawPrice(side), flow.DrawQuantity(), NoParticipant, expiry });
+            }
+            else if(kind < 80){
+                request = OrderRequest::Cancel(flow.DrawKnownId());
+            }
+            else{
+                request = OrderRequest::Modify(OrderModify{ flow.DrawKnownId(), side, flow.DrawPrice(side), flow.DrawQuantity() });
+            }
+            manager.Submit(symbols[symbolIndex], request);
+            Trades trades;
+            expected[symbolIndex]->ApplyBatch(&request, 1, trades);
+            expectedTrades[symbols[symbolIndex]] += trades.size();
+
+            if(step % 997 == 0 || step + 1 == options.iterations_){
+                manager.Flush();
+                bool same = true;
+                for(std::size_t i = 0; i < SymbolCount; ++i){
+                    const Orderbook* book = manager.GetOrderbook(symbols[i]);
+                    // Books are created by the first message for their symbol
+                    same = same && (book == nullptr ? expected[i]->Size() == 0
+                                                    : SameDepth(*book, *expected[i]) && book->GetTime() == expected[i]->GetTime()
+                                                        && DescribeOrders(*book) == DescribeOrders(*expected[i]));
+                }
+                std::lock_guard<std::mutex> lock{ tradesMutex };
+                for(std::size_t i = 0; i < SymbolCount; ++i){
+                    same = same && tradedBySymbol[symbols[i]] == expectedTrades[symbols[i]];
+                }
+                if(!Expect(same, test, "sharded books differ from single-threaded ones", step)){
+                    break;
+                }
+            }
+        }
+        // A symbol first seen after the clock moved gets a book at that
+        // time, which rejects an add that has already expired
+        manager.AdvanceTime(now + 1000);
+        manager.Submit(9, OrderRequest::Add(Order{ OrderType::GoodTillTime, flow.nextOrderId_++, Side::Buy, 1000, 1, NoParticipant, now + 1 }));
+        manager.Flush();
+        const Orderbook* late = manager.GetOrderbook(9);
+        if(!Expect(late != nullptr && late->GetTime() == now + 1000 && late->Size() == 0, test, "late book did not start at the shard's time", 0)){
+            manager.Stop();
+            return;
+        }
+
+        // GoodForDay orders expire at the session end, including in a book
+        // created after it was set, and at an explicit end-of-day expiry
+        manager.SetSessionEnd(now + 5000);
+        manager.Submit(9, OrderRequest::Add(Order{ OrderType::GoodForDay, flow.nextOrderId_++, Side::Buy, 1000, 1 }));
+        manager.Submit(10, OrderRequest::Add(Order{ OrderType::GoodForDay, flow.nextOrderId_++, Side::Sell, 1010, 1 }));
+        manager.Flush();
+        const Orderbook* later = manager.GetOrderbook(10);
+        bool rested = late->Size() == 1 && later != nullptr && later->Size() == 1 && later->GetSessionEnd() == now + 5000;
+        manager.AdvanceTime(now + 5000);
+        manager.Flush();
+        if(!Expect(rested && late->Size() == 0 && later->Size() == 0, test, "GoodForDay orders outlived the session end", 1)){
+            manager.Stop();
+            return;
+        }
+        manager.SetSessionEnd(0);
+        manager.Submit(9, OrderRequest::Add(Order{ OrderType::GoodForDay, flow.nextOrderId_++, Side::Buy, 1000, 1 }));
+        manager.ExpireGoodForDayOrders();
+        manager.Flush();
+        Expect(late->Size() == 0 && late->GetSessionEnd() == 0, test, "end-of-day expiry missed a GoodForDay order", 2);
+        manager.Stop();
+        Expect(manager.GetOrderbook(3) == nullptr, test, "book created for a symbol that saw no flow", 0);
+    }
+
+    // Registering a symbol once the workers run is refused, and a CPU the
+    // workers cannot be pinned to fails Start instead of running unpinned
+    void TestManagerStart(const TestOptions&)
+    {
+        const char* test = "manager start";
+        OrderbookManagerConfig config;
+        config.shardCount_ = 2;
+        config.queueCapacity_ = 16;
+        OrderbookManager manager{ config };
+        manager.Start();
+        bool refused = false;
+        try{
+            manager.RegisterSymbol(1, config.defaultBookConfig_);
+        }
+        catch(const std::logic_error&){
+            refused = true;
+        }
+        manager.Stop();
+        Expect(refused && manager.GetOrderbook(1) == nullptr, test, "symbol registered while the workers ran", 0);
+#ifdef __linux__
+        config.pinThreads_ = true;
+        config.firstCpu_ = -1;
+        OrderbookManager unpinnable{ config };
+        bool failed = false;
+        try{
+            unpinnable.Start();
+        }
+        catch(const std::runtime_error&){
+            failed = true;
+        }
+        Expect(failed, test, "Start succeeded with a CPU out of range", 1);
+#endif
+    }
+
+    // Batches that empty levels and rebuild them at the same price, inside
+    // a narrow ladder and beyond it, must still report each changed level
+    // once and keep a shadow depth in step with the book
+    void TestBatchLevelUpdates(const TestOptions& options)
+    {
+        const char* test = "level batches";
+        for(Price ladderTicks : { 0, 4 }){
+            OrderbookConfig config;
+            config.referencePrice_ = 1000;
+            config.ladderTicks_ = ladderTicks;
+            config.levelUpdates_ = true;
+            Orderbook orderbook{ config };
+            std::map<std::pair<int, Price>, LevelInfo> shadow;
+            Flow flow{ options.seed_ * 13 + static_cast<std::uint64_t>(ladderTicks) };
+            for(std::size_t step = 0; step < options.iterations_ / 20; ++step){
+                OrderRequests requests;
+                for(std::size_t i = 0; i < 1 + flow.Draw(24); ++i){
+                    Side side = flow.DrawSide();
+                    if(flow.Chance(45)){
+                        requests.push_back(OrderRequest::Cancel(flow.DrawKnownId()));
+                    }
+                    else{
+                        requests.push_back(OrderRequest::Add(Order{ DrawOrderType(flow), flow.nextOrderId_++, side, flow.DrawPrice(side), flow.DrawQuantity() }));
+                    }
+                }
+                orderbook.ApplyBatch(requests);
+                std::map<std::pair<int, Price>, int> reported;
+                bool once = true;
+                for(const LevelUpdate& update : orderbook.GetLevelUpdates()){
+                    once = once && ++reported[std::make_pair(static_cast<int>(update.side_), update.price_)] == 1;
+                }
+                ApplyLevelUpdates(orderbook, shadow);
+                if(!Expect(once, test, "level reported twice in one batch", step)
+                    || !Expect(MatchesShadow(orderbook, shadow), test, "L2 updates differ from the depth", step)){
+                    return;
+                }
+            }
+        }
+    }
+
+    // A snapshot taken after the session end and well into the day must
+    // bring back the book time and session end with its orders: a tail
+    // GoodTillTime add already expired by then is rejected again, and a
+    // tail GoodForDay order still expires at the next advance
+    void TestClockRecovery(const TestOptions&)
+    {
+        const char* test = "clock recovery";
+        std::string journalPath = TempPath("clock_journal");
+        std::string snapshotPath = TempPath("clock_snapshot");
+        OrderbookConfig config;
+        config.digest_ = true;
+        Orderbook live{ config };
+        live.AdvanceTime(5000000);
+        live.AddOrder(Order{ OrderType::GoodTillTime, 1, Side::Buy, 99, 10, NoParticipant, 9000000 });
+        live.AddOrder(Order{ OrderType::GoodTillCancel, 2, Side::Sell, 101, 10 });
+        OrderbookSnapshot::Capture(live, 0).Write(snapshotPath);
+        {
+            OrderbookJournal journal{ journalPath };
+            OrderbookEventLoop loop{ live, 16 };
+            loop.SetJournal(&journal);
+            // The session end and the end-of-day expiry come after the
+            // snapshot, so only the journal carries them
+            loop.Post(OrderMessage::FromRequest(0, OrderRequest::SetSessionEnd(7000000)));
+            loop.Post(OrderMessage::FromRequest(0, OrderRequest::Add(Order{ OrderType::GoodTillTime, 3, Side::Buy, 98, 10, NoParticipant, 4500000 })));
+            loop.Post(OrderMessage::FromRequest(0, OrderRequest::Add(Order{ OrderType::GoodForDay, 5, Side::Sell, 103, 10 })));
+            loop.Post(OrderMessage::FromRequest(0, OrderRequest::ExpireGoodForDay()));
+            loop.Post(OrderMessage::FromRequest(0, OrderRequest::Add(Order{ OrderType::GoodForDay, 4, Side::Sell, 102, 10 })));
+            while(loop.Poll()){
+            }
+        }
+        Orderbook recovered{ config };
+        RecoverOrderbook(recovered, snapshotPath, { journalPath });
+        ::unlink(journalPath.c_str());
+        ::unlink(snapshotPath.c_str());
+        auto same = [&](){
+            return recovered.GetDigest() == live.GetDigest() && DescribeOrders(recovered) == DescribeOrders(live)
+                && recovered.GetTime() == live.GetTime() && recovered.GetSessionEnd() == live.GetSessionEnd()
+                && recovered.GetScheduledExpiryCount() == live.GetScheduledExpiryCount();
+        };
+        if(!Expect(live.Size() == 3 && live.GetSessionEnd() == 7000000 && same(), test, "recovered book differs", 0)){
+            return;
+        }
+        std::size_t step = 1;
+        for(Timestamp now : { Timestamp{ 5000001 }, Timestamp{ 9000000 } }){
+            std::size_t expired = live.AdvanceTime(now);
+            if(!Expect(recovered.AdvanceTime(now) == expired && same(), test, "recovered book expired different orders", step++)){
+                return;
+            }
+        }
+        Expect(live.Size() == 1, test, "expiries did not fire", step);
+    }
+
+    // Orders a risk check rejected live must stay rejected on replay: the
+    // journal has to carry the participant they were checked against and
+    // the limits set while the book ran, and a snapshot taken in the
+    // middle of a message rate window the messages already counted in it
+    void TestRiskRejectRecovery(const TestOptions&)
+    {
+        const char* test = "risk recovery";
+        std::string journalPath = TempPath("risk_journal");
+        OrderbookConfig config;
+        config.riskLimits_.maxOpenOrders_ = 1;
+        Orderbook live{ config };
+        {
+            OrderbookJournal journal{ journalPath };
+            OrderbookEventLoop loop{ live, 16 };
+            loop.SetJournal(&journal);
+            for(OrderId orderId = 1; orderId <= 5; ++orderId){
+                loop.Post(OrderMessage::FromRequest(0, OrderRequest::Add(Order{ OrderType::GoodTillCancel, orderId, Side::Buy,
+                                                                                100 - static_cast<Price>(orderId), 10, 1 })));
+            }
+            while(loop.Poll()){
+            }
+        }
+        Orderbook recovered{ config };
+        RecoverOrderbook(recovered, std::string{}, { journalPath });
+        ::unlink(journalPath.c_str());
+        if(!Expect(live.Size() == 1 && recovered.Size() == 1 && DescribeOrders(recovered) == DescribeOrders(live)
+                   && recovered.GetParticipantOrderCount(1) == 1, test, "rejected orders came back on replay", 0)){
+            return;
+        }
+
+        // Three messages per window, set on the running book; the snapshot
+        // falls after the first two adds of the window
+        std::string snapshotPath = TempPath("risk_snapshot");
+        RiskLimits limits;
+        limits.maxMessages_ = 3;
+        limits.messageWindow_ = 1000000;
+        Orderbook windowed{ OrderbookConfig{} };
+        {
+            OrderbookJournal journal{ journalPath };
+            OrderbookEventLoop loop{ windowed, 16 };
+            loop.SetJournal(&journal);
+            bool captured = false;
+            loop.SetSnapshotPolicy(4, [&](OrderbookSnapshot&& snapshot){
+                if(!captured){
+                    snapshot.Write(snapshotPath);
+                    captured = true;
+                }
+            });
+            loop.Post(OrderMessage::FromRequest(0, OrderRequest::SetRiskLimits(2, limits)));
+            loop.Post(OrderMessage::FromRequest(0, OrderRequest::AdvanceTime(100)));
+            for(OrderId orderId = 1; orderId <= 5; ++orderId){
+                if(orderId == 5){
+                    loop.Post(OrderMessage::FromRequest(0, OrderRequest::AdvanceTime(1000100)));
+                }
+                loop.Post(OrderMessage::FromRequest(0, OrderRequest::Add(Order{ OrderType::GoodTillCancel, orderId, Side::Sell,
+                                                                                100 + static_cast<Price>(orderId), 10, 2 })));
+            }
+            while(loop.Poll()){
+            }
+            journal.Flush();
+        }
+        Orderbook fromSnapshot{ OrderbookConfig{} };
+        RecoverOrderbook(fromSnapshot, snapshotPath, { journalPath });
+        Orderbook fromJournal{ OrderbookConfig{} };
+        RecoverOrderbook(fromJournal, std::string{}, { journalPath });
+        ::unlink(journalPath.c_str());
+        ::unlink(snapshotPath.c_str());
+        for(const Orderbook* restored : { &fromSnapshot, &fromJournal }){
+            if(!Expect(windowed.Size() == 4 && DescribeOrders(*restored) == DescribeOrders(windowed)
+                       && restored->GetParticipantOrderCount(2) == 4, test, "message rate window differs after recovery", 1)){
+                return;
+            }
+        }
+    }
+
+    // Adds and modifies for zero or a negative quantity are rejected before
+    // the risk stage: nothing rests, nothing counts against the open order
+    // limit, and a rejected modify leaves the original as it was
+    void TestInvalidQuantity(const TestOptions&)
+    {
+        const char* test = "invalid quantity";
+        const std::string Invalid = " " + std::to_string(static_cast<int>(RejectReason::InvalidQuantity)) + "\n";
+        OrderbookConfig config;
+        config.riskLimits_.maxOpenOrders_ = 2;
+        Orderbook orderbook{ config };
+        RecordingSink sink;
+        orderbook.SetEventSink(&sink);
+        orderbook.AddOrder(Order{ OrderType::GoodTillCancel, 1, Side::Buy, 100, 0, 1 });
+        orderbook.AddOrder(Order{ OrderType::GoodTillCancel, 2, Side::Sell, 101, -5, 1 });
+        if(!Expect(sink.Take() == "R 1" + Invalid + "R 2" + Invalid && orderbook.Size() == 0
+                       && orderbook.GetParticipantOrderCount(1) == 0, test, "empty add not rejected", 0)){
+            return;
+        }
+        orderbook.AddOrder(Order{ OrderType::GoodTillCancel, 3, Side::Buy, 100, 10, 1 });
+        sink.Take();
+        orderbook.ModifyOrder(OrderModify{ 3, Side::Buy, 100, 0 });
+        orderbook.ModifyOrder(OrderModify{ 3, Side::Buy, 99, -1 });
+        OrderbookLevelInfos infos = orderbook.GetOrderInfos();
+        if(!Expect(sink.Take() == "R 3" + Invalid + "R 3" + Invalid && infos.GetBids().size() == 1 && infos.GetBids()[0].price_ == 100
+                       && infos.GetBids()[0].quantity_ == 10, test, "empty modify not rejected", 1)){
+            return;
+        }
+        orderbook.AddOrder(Order{ OrderType::GoodTillCancel, 4, Side::Buy, 99, 10, 1 });
+        Expect(orderbook.Size() == 2 && orderbook.GetParticipantOrderCount(1) == 2, test, "rejected orders counted against the limit", 2);
+    }
+
+    // The async sink hands its downstream exactly what a synchronous one sees
+    void TestAsyncSink(const TestOptions& options)
+    {
+        const char* test = "async sink";
+        RecordingSink direct;
+        RecordingSink downstream;
+        Orderbook syncBook;
+        Orderbook asyncBook;
+        syncBook.SetEventSink(&direct);
+        {
+            AsyncEventSink async{ downstream, 64 };
+            asyncBook.SetEventSink(&async);
+            Flow flow{ options.seed_ * 5 + 2 };
+            for(std::size_t step = 0; step < options.iterations_ / 4; ++step){
+                Side side = flow.DrawSide();
+                if(flow.Chance(60)){
+                    Order order{ DrawOrderType(flow), flow.nextOrderId_++, side, flow.DrawPrice(side), flow.DrawQuantity(),
+                                 static_cast<ParticipantId>(flow.Draw(4)) };
+                    syncBook.AddOrder(order);
+                    asyncBook.AddOrder(order);
+                }
+                else{
+                    OrderModify modify{ flow.DrawKnownId(), side, flow.DrawPrice(side), flow.DrawQuantity() };
+                    syncBook.ModifyOrder(modify);
+                    asyncBook.ModifyOrder(modify);
+                }
+            }
+            async.Flush();
+            asyncBook.SetEventSink(nullptr);
+        }
+        Expect(direct.Take() == downstream.Take(), test, "events differ from the synchronous sink", 0);
+    }
+
+    // A buy sweeping most of a deep level fills it in queue order and
+    // leaves the rest of that level where it was, still first in line
+    void TestDeepSweep(const TestOptions&)
+    {
+        const char* test = "sweep";
+        const Quantity Depth = 1000;
+        Orderbook orderbook;
+        for(OrderId orderId = 1; orderId <= Depth; ++orderId){
+            orderbook.AddOrder(Order{ OrderType::GoodTillCancel, orderId, Side::Sell, 100, 1 });
+        }
+        orderbook.AddOrder(Order{ OrderType::GoodTillCancel, Depth + 1, Side::Sell, 101, 5 });
+        Trades sweep = orderbook.AddOrder(Order{ OrderType::GoodTillCancel, Depth + 2, Side::Buy, 100, Depth - 1 });
+        bool inOrder = sweep.size() == static_cast<std::size_t>(Depth - 1);
+        for(std::size_t i = 0; inOrder && i < sweep.size(); ++i){
+            inOrder = SameFill(sweep[i], Depth + 2, static_cast<OrderId>(i + 1), 1);
+        }
+        if(!Expect(inOrder, test, "deep level not filled in queue order", 0)){
+            return;
+        }
+        Trades rest = orderbook.AddOrder(Order{ OrderType::GoodTillCancel, Depth + 3, Side::Buy, 101, 3 });
+        OrderbookLevelInfos infos = orderbook.GetOrderInfos();
+        Expect(rest.size() == 2 && SameFill(rest[0], Depth + 3, Depth, 1) && SameFill(rest[1], Depth + 3, Depth + 1, 2)
+                   && orderbook.Size() == 1 && infos.GetBids().empty() && infos.GetAsks().size() == 1 && infos.GetAsks()[0].quantity_ == 3,
+               test, "rest of the level or the next level wrong after the sweep", 1);
+    }
+
+    // A slot freed by a cancel or a fill goes to the next order, which must
+    // still queue behind every order already resting at its level
+    void TestSlotReuse(const TestOptions& options)
+    {
+        const char* test = "slot reuse";
+        OrderbookConfig config;
+        config.orderCapacity_ = 4;
+        Orderbook orderbook{ config };
+        Flow flow{ options.seed_ * 3 + 1 };
+        std::vector<OrderId> queue;
+        for(std::size_t step = 0; step < options.iterations_ / 10; ++step){
+            if(queue.empty() || flow.Chance(60)){
+                queue.push_back(flow.nextOrderId_++);
+                orderbook.AddOrder(Order{ OrderType::GoodTillCancel, queue.back(), Side::Sell, 100, 1 });
+            }
+            else if(flow.Chance(50)){
+                std::size_t index = static_cast<std::size_t>(flow.Draw(queue.size()));
+                orderbook.CancelOrder(queue[index]);
+                queue.erase(queue.begin() + static_cast<std::ptrdiff_t>(index));
+            }
+            else{
+                // Fills the head of the queue
+                Trades trades = orderbook.AddOrder(Order{ OrderType::FillandKill, flow.nextOrderId_++, Side::Buy, 100, 1 });
+                bool head = trades.size() == 1 && trades[0].GetAskTrade().orderId_ == queue.front();
+                queue.erase(queue.begin());
+                if(!Expect(head, test, "fill did not take the oldest order", step)){
+                    return;
+                }
+            }
+            if(!Expect(orderbook.Size() == queue.size(), test, "book size differs from the queue", step)){
+                return;
+            }
+        }
+    }
+
+    // Levels inside an 8-tick band and in the overflow map on either side
+    // of it: a sweep moves between the two in price order, the best bid
+    // falls back to the map once the band empties, and depth lists both in
+    // priority order
+    void TestLadderBand(const TestOptions&)
+    {
+        const char* test = "ladder band";
+        OrderbookConfig config;
+        config.referencePrice_ = 1000;
+        config.ladderTicks_ = 8;
+        Orderbook orderbook{ config };
+        const Price bids[] = { 980, 998, 1010, 996 };
+        const Price asks[] = { 1040, 1015 };
+        OrderId orderId = 1;
+        for(Price price : bids){
+            orderbook.AddOrder(Order{ OrderType::GoodTillCancel, orderId++, Side::Buy, price, 5 });
+        }
+        for(Price price : asks){
+            orderbook.AddOrder(Order{ OrderType::GoodTillCancel, orderId++, Side::Sell, price, 5 });
+        }
+        OrderbookLevelInfos infos = orderbook.GetOrderInfos();
+        const Price bidOrder[] = { 1010, 998, 996, 980 };
+        bool depth = infos.GetBids().size() == 4 && infos.GetAsks().size() == 2
+            && infos.GetAsks()[0].price_ == 1015 && infos.GetAsks()[1].price_ == 1040;
+        for(std::size_t i = 0; depth && i < 4; ++i){
+            depth = infos.GetBids()[i].price_ == bidOrder[i];
+        }
+        if(!Expect(depth, test, "depth across the band and the map out of order", 0)){
+            return;
+        }
+        Trades trades = orderbook.AddOrder(Order{ OrderType::GoodTillCancel, orderId++, Side::Sell, 970, 17 });
+        bool sweep = trades.size() == 4 && trades[3].GetBidTrade().quantity_ == 2;
+        for(std::size_t i = 0; sweep && i < 4; ++i){
+            sweep = trades[i].GetBidTrade().price_ == bidOrder[i];
+        }
+        infos = orderbook.GetOrderInfos();
+        Expect(sweep && infos.GetBids().size() == 1 && infos.GetBids()[0].price_ == 980 && infos.GetBids()[0].quantity_ == 3,
+               test, "sweep did not move between the band and the map in price order", 1);
+    }
+
+    // Both index modes from a tiny starting capacity: duplicates are
+    // rejected, an id below the direct base and ids far past the first run
+    // are still found, and every resting order can be cancelled by id
+    void TestOrderIndex(const TestOptions&)
+    {
+        const char* test = "order index";
+        for(OrderIndexMode mode : { OrderIndexMode::Hashed, OrderIndexMode::Direct }){
+            OrderbookConfig config;
+            config.orderIndexMode_ = mode;
+            config.baseOrderId_ = 1;
+            config.orderCapacity_ = 4;
+            Orderbook orderbook{ config };
+            std::vector<OrderId> resting;
+            auto add = [&](OrderId orderId){
+                orderbook.AddOrder(Order{ OrderType::GoodTillCancel, orderId, Side::Buy, 500 - static_cast<Price>(orderId % 50), 1 });
+                resting.push_back(orderId);
+            };
+            for(OrderId orderId = 0; orderId <= 200; ++orderId){
+                add(orderId);
+            }
+            orderbook.AddOrder(Order{ OrderType::GoodTillCancel, 7, Side::Buy, 400, 1 });
+            for(OrderId orderId = 1; orderId <= 200; orderId += 2){
+                orderbook.CancelOrder(orderId);
+                orderbook.CancelOrder(orderId);
+            }
+            for(OrderId orderId = 1000000; orderId <= 1000100; ++orderId){
+                add(orderId);
+            }
+            if(!Expect(orderbook.Size() == resting.size() - 100 && orderbook.GetOrderInfos().GetBids().back().price_ == 451,
+                       test, "duplicate id accepted or cancel missed", mode == OrderIndexMode::Direct)){
+                return;
+            }
+            for(OrderId orderId : resting){
+                if(orderId == 0 || orderId % 2 == 0 || orderId > 200){
+                    orderbook.CancelOrder(orderId);
+                }
+            }
+            if(!Expect(orderbook.Size() == 0, test, "resting order not found by id", mode == OrderIndexMode::Direct)){
+                return;
+            }
+        }
+    }
+
+    // The book does no I/O of its own: a scripted session writes nothing to
+    // std::cout, and every refusal reaches the sink with its reason
+    void TestEvents(const TestOptions&)
+    {
+        const char* test = "events";
+        RecordingSink sink;
+        Orderbook orderbook;
+        orderbook.SetEventSink(&sink);
+        std::ostringstream console;
+        std::streambuf* previous = std::cout.rdbuf(console.rdbuf());
+        orderbook.AddOrder(Order{ OrderType::GoodTillCancel, 1, Side::Sell, 100, 10 });
+        orderbook.AddOrder(Order{ OrderType::GoodTillCancel, 1, Side::Sell, 101, 10 });
+        orderbook.AddOrder(Order{ OrderType::FillandKill, 2, Side::Buy, 99, 5 });
+        orderbook.CancelOrder(3);
+        orderbook.ModifyOrder(OrderModify{ 3, Side::Buy, 100, 5 });
+        Trades trades = orderbook.AddOrder(Order{ OrderType::GoodTillCancel, 4, Side::Buy, 100, 4 });
+        orderbook.ModifyOrder(OrderModify{ 1, Side::Sell, 100, 3 });
+        orderbook.CancelOrder(1);
+        std::cout.rdbuf(previous);
+
+        std::istringstream events{ sink.Take() };
+        std::string rejects;
+        std::size_t tradeEvents = 0;
+        for(std::string line; std::getline(events, line);){
+            rejects += line[0] == 'R' ? line + '\n' : std::string{};
+            tradeEvents += line[0] == 'T' ? 1 : 0;
+        }
+        auto reject = [](OrderId orderId, RejectReason reason){
+            return "R " + std::to_string(orderId) + ' ' + std::to_string(static_cast<int>(reason)) + '\n';
+        };
+        std::string expected = reject(1, RejectReason::DuplicateOrderId) + reject(2, RejectReason::NoImmediateMatch)
+            + reject(3, RejectReason::CancelUnknownOrder) + reject(3, RejectReason::ModifyUnknownOrder);
+        Expect(console.str().empty() && rejects == expected && tradeEvents == 1 && trades.size() == 1 && orderbook.Size() == 0,
+               test, "book wrote to std::cout or events differ", 0);
+    }
+
+    // Top-N depth against the first N levels of the reference, with a band
+    // narrow enough that the best levels are split between the ladder and
+    // the overflow map
+    void TestTopDepth(const TestOptions& options)
+    {
+        const char* test = "top depth";
+        OrderbookConfig config;
+        config.referencePrice_ = 1000;
+        config.ladderTicks_ = 4;
+        Orderbook orderbook{ config };
+        ReferenceBook reference;
+        Flow flow{ options.seed_ * 19 + 4 };
+        auto top = [](LevelInfos levels, std::size_t maxLevels){
+            levels.resize(std::min(levels.size(), maxLevels));
+            return levels;
+        };
+        for(std::size_t step = 0; step < options.iterations_ / 4; ++step){
+            Side side = flow.DrawSide();
+            if(flow.Chance(70)){
+                Order order{ OrderType::GoodTillCancel, flow.nextOrderId_++, side, flow.DrawPrice(side), flow.DrawQuantity() };
+                reference.Add(order);
+                orderbook.AddOrder(order);
+            }
+            else{
+                OrderId orderId = flow.DrawKnownId();
+                reference.Cancel(orderId);
+                orderbook.CancelOrder(orderId);
+            }
+            std::size_t maxLevels = static_cast<std::size_t>(flow.Draw(6));
+            OrderbookLevelInfos infos = orderbook.GetOrderInfos(maxLevels);
+            if(!Expect(SameLevels(infos.GetBids(), top(reference.Levels(Side::Buy), maxLevels))
+                           && SameLevels(infos.GetAsks(), top(reference.Levels(Side::Sell), maxLevels)),
+                       test, "top levels differ from the reference", step)){
+                return;
+            }
+        }
+    }
+
+    bool SameTrade(const Trade& left, const Trade& right)
+    {
+        return left.GetBidTrade().orderId_ == right.GetBidTrade().orderId_ && left.GetBidTrade().price_ == right.GetBidTrade().price_
+            && left.GetBidTrade().quantity_ == right.GetBidTrade().quantity_ && left.GetAskTrade().orderId_ == right.GetAskTrade().orderId_
+            && left.GetAskTrade().price_ == right.GetAskTrade().price_ && left.GetAskTrade().quantity_ == right.GetAskTrade().quantity_;
+    }
+
+    // The returned vector, a caller buffer that is appended to and never
+    // cleared, and a fill callback must all see the same trades
+    void TestTradeOutputs(const TestOptions& options)
+    {
+        const char* test = "trade outputs";
+        Orderbook byValue;
+        Orderbook intoBuffer;
+        Orderbook throughCallback;
+        Trades returned;
+        Trades buffer;
+        Trades called;
+        auto onTrade = [&called](const Trade& trade){ called.push_back(trade); };
+        Flow flow{ options.seed_ * 23 + 6 };
+        for(std::size_t step = 0; step < options.iterations_ / 4 + 200; ++step){
+            Side side = flow.DrawSide();
+            if(flow.Chance(70)){
+                Order order{ DrawOrderType(flow), flow.nextOrderId_++, side, flow.DrawPrice(side), flow.DrawQuantity() };
+                Trades trades = byValue.AddOrder(order);
+                returned.insert(returned.end(), trades.begin(), trades.end());
+                intoBuffer.AddOrder(order, buffer);
+                throughCallback.AddOrder(order, onTrade);
+            }
+            else{
+                OrderModify modify{ flow.DrawKnownId(), side, flow.DrawPrice(side), flow.DrawQuantity() };
+                Trades trades = byValue.ModifyOrder(modify);
+                returned.insert(returned.end(), trades.begin(), trades.end());
+                intoBuffer.ModifyOrder(modify, buffer);
+                throughCallback.ModifyOrder(modify, onTrade);
+            }
+        }
+        bool same = !returned.empty() && buffer.size() == returned.size() && called.size() == returned.size();
+        for(std::size_t i = 0; same && i < returned.size(); ++i){
+            same = SameTrade(buffer[i], returned[i]) && SameTrade(called[i], returned[i]);
+        }
+        Expect(same, test, "buffer or callback trades differ from the returned ones", 0);
+    }
+
+    // A same-price reduction keeps the order's place in the queue; raising
+    // the quantity sends it to the back like any cancel and replace
+    void TestAmendPriority(const TestOptions&)
+    {
+        const char* test = "amend priority";
+        RecordingSink sink;
+        Orderbook orderbook;
+        for(OrderId orderId = 1; orderId <= 3; ++orderId){
+            orderbook.AddOrder(Order{ OrderType::GoodTillCancel, orderId, Side::Sell, 100, 10 });
+        }
+        orderbook.SetEventSink(&sink);
+        orderbook.ModifyOrder(OrderModify{ 1, Side::Sell, 100, 4 });
+        std::string events = sink.Take();
+        bool modifyOnly = events.compare(0, 2, "M ") == 0 && events.find('\n') + 1 == events.size();
+        orderbook.ModifyOrder(OrderModify{ 2, Side::Sell, 100, 15 });
+        OrderbookLevelInfos infos = orderbook.GetOrderInfos();
+        Trades trades = orderbook.AddOrder(Order{ OrderType::GoodTillCancel, 4, Side::Buy, 100, 30 });
+        Expect(modifyOnly && infos.GetAsks().size() == 1 && infos.GetAsks()[0].quantity_ == 29 && infos.GetAsks()[0].orderCount_ == 3
+                   && trades.size() == 3 && SameFill(trades[0], 4, 1, 4) && SameFill(trades[1], 4, 3, 10) && SameFill(trades[2], 4, 2, 15),
+               test, "amend lost or kept queue priority wrongly", 0);
+    }
+
+    // AddOrders and ApplyBatch give the trades of the same messages applied
+    // one at a time, so a cancel later in a batch cannot take back
+    // liquidity an earlier order in it has already traded against
+    void TestBatchEntry(const TestOptions& options)
+    {
+        const char* test = "batch entry";
+        Orderbook single;
+        Orderbook batched;
+        Flow flow{ options.seed_ * 29 + 8 };
+        std::size_t tradeCount = 0;
+        for(std::size_t step = 0; step < options.iterations_ / 40 + 50; ++step){
+            std::vector<Order> orders;
+            Trades expected;
+            for(std::size_t i = 0; i < 1 + flow.Draw(20); ++i){
+                Side side = flow.DrawSide();
+                orders.push_back(Order{ DrawOrderType(flow), flow.nextOrderId_++, side, flow.DrawPrice(side), flow.DrawQuantity() });
+                single.AddOrder(orders.back(), expected);
+            }
+            Trades trades = batched.AddOrders(orders);
+            bool same = trades.size() == expected.size();
+            for(std::size_t i = 0; same && i < trades.size(); ++i){
+                same = SameTrade(trades[i], expected[i]);
+            }
+            tradeCount += trades.size();
+            if(!Expect(same, test, "AddOrders trades differ from single adds", step)){
+                return;
+            }
+        }
+
+        Orderbook orderbook;
+        OrderRequests requests{
+            OrderRequest::Add(Order{ OrderType::GoodTillCancel, 1, Side::Sell, 100, 10 }),
+            OrderRequest::Add(Order{ OrderType::GoodTillCancel, 2, Side::Buy, 100, 4 }),
+            OrderRequest::Cancel(1),
+            OrderRequest::Add(Order{ OrderType::GoodTillCancel, 3, Side::Buy, 100, 4 }),
+        };
+        Trades trades = orderbook.ApplyBatch(requests);
+        Expect(tradeCount > 0 && trades.size() == 1 && SameFill(trades[0], 2, 1, 4) && orderbook.Size() == 1,
+               test, "batch did not match message by message", 0);
+    }
+
+    bool ParseOption(const char* arg, const char* name, std::uint64_t& value)
+    {
+        std::size_t length = std::strlen(name);
+        if(std::strncmp(arg, name, length) != 0 || arg[length] != '='){
+            return false;
+        }
+        value = std::strtoull(arg + length + 1, nullptr, 10);
+        return true;
+    }
+}
+
+// --- Main Test Logic ---
+int main(int argc, char** argv){
+    TestOptions options;
+    for(int i = 1; i < argc; ++i){
+        std::uint64_t value = 0;
+        if(ParseOption(argv[i], "--seed", value)){
+            options.seed_ = value;
+        }
+        else if(ParseOption(argv[i], "--iterations", value)){
+            options.iterations_ = static_cast<std::size_t>(value);
+        }
+        else{
+            std::fprintf(stderr, "usage: %s [--seed=N] [--iterations=N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    struct NamedTest
+    {
+        const char* name_;
+        void (*run_)(const TestOptions&);
+    };
+    const NamedTest tests[] = {
+        { "reference", TestAgainstReference },
+        { "backends", TestBackendsAgree },
+        { "auction", TestAuction },
+        { "expiry", TestExpiry },
+        { "recovery", TestRecovery },
+        { "snapshot header", TestSnapshotHeader },
+        { "session cancels", TestParticipantRestore },
+        { "auction recovery", TestAuctionRecovery },
+        { "clock recovery", TestClockRecovery },
+        { "risk recovery", TestRiskRejectRecovery },
+        { "manager", TestManager },
+        { "manager start", TestManagerStart },
+        { "level batches", TestBatchLevelUpdates },
+        { "invalid quantity", TestInvalidQuantity },
+        { "async sink", TestAsyncSink },
+        { "sweep", TestDeepSweep },
+        { "slot reuse", TestSlotReuse },
+        { "ladder band", TestLadderBand },
+        { "order index", TestOrderIndex },
+        { "events", TestEvents },
+        { "top depth", TestTopDepth },
+        { "trade outputs", TestTradeOutputs },
+        { "amend priority", TestAmendPriority },
+        { "batch entry", TestBatchEntry },
+    };
+    for(const NamedTest& test : tests){
+        int before = failures;
+        test.run_(options);
+        std::printf("%-16s %s\n", test.name_, failures == before ? "ok" : "FAILED");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include "orderbook_ingress.h"
+
+#include <cmath>
+#include <random>
+
+// --- WorkloadConfig Struct ---
+// Synthetic order flow around a slowly drifting mid price. Passive orders
+// rest a power-law distance behind the touch, the book is held near depth_
+// orders per side, and arrivals alternate between a base Poisson rate and
+// bursts of burstMultiplier_ times that rate.
+struct WorkloadConfig
+{
+    std::uint64_t seed_{ 1 };
+    SymbolId symbol_{ 0 };
+    OrderId firstOrderId_{ 1 };
+    Price midPrice_{ 10000 };
+    std::size_t depth_{ 10000 };          // Resting orders per side
+    Price levels_{ 100 };                 // Passive orders rest at most this many ticks behind the touch
+    double distanceExponent_{ 3.0 };      // Distance is levels * u^exponent; 1 is uniform
+    Quantity maxQuantity_{ 100 };
+    double midMoveProbability_{ 0.001 };  // Per message, the mid moves one tick either way
+
+    // Relative weights of the message kinds once the book is built
+    double addWeight_{ 0.45 };
+    double cancelWeight_{ 0.40 };
+    double modifyWeight_{ 0.10 };
+    double fillAndKillWeight_{ 0.05 };
+
+    // Arrival schedule written to OrderMessage::timestamp_, in ns from the
+    // first message after warm-up. A rate of 0 leaves every timestamp at 0.
+    double rate_{ 0 };                    // Mean messages per second outside bursts
+    double burstProbability_{ 0.0005 };   // Per message, a burst starts
+    double burstMultiplier_{ 10 };
+    double burstLength_{ 500 };           // Mean messages per burst
+};
+
+enum class WorkloadMessageKind : std::uint8_t
+{
+    Add,
+    Cancel,
+    Modify,
+    FillAndKill,
+    Count
+};
+
+inline const char* ToString(WorkloadMessageKind kind)
+{
+    switch(kind)
+    {
+    case WorkloadMessageKind::Add: return "Add";
+    case WorkloadMessageKind::Cancel: return "Cancel";
+    case WorkloadMessageKind::Modify: return "Modify";
+    case WorkloadMessageKind::FillAndKill: return "FillAndKill";
+    case WorkloadMessageKind::Count: break;
+    }
+    return "?";
+}
+
+// --- WorkloadGenerator Class ---
+// Produces the flow as OrderMessages, so the same stream can drive a book
+// directly, go through an ingress ring or be written out as a capture for
+// orderbook_replay. The first GetWarmupCount() messages are passive adds
+// that build the book to depth; the mix and the arrival schedule start
+// after them. Order ids count up from firstOrderId_, which suits
+// OrderIndexMode::Direct with that base.
+//
+// The generator tracks its own resting orders but cannot see fills, so a
+// cancel or modify occasionally names an order the flow has already
+// traded away and is rejected by the book, as happens in production.
+class WorkloadGenerator
+{
+public:
+    explicit WorkloadGenerator(const WorkloadConfig& config)
+        : config_{ config }
+        , rng_{ config.seed_ }
+        , nextOrderId_{ config.firstOrderId_ }
+        , mid_{ config.midPrice_ }
+        , kinds_{ { config.addWeight_, config.cancelWeight_, config.modifyWeight_, config.fillAndKillWeight_ } }
+    {
+        live_.reserve(config_.depth_ * 2 + 1024);
+    }
+
+    std::size_t GetWarmupCount() const { return config_.depth_ * 2; }
+
+    // The next message, with the kind of flow it represents in kind
+    OrderMessage Next(WorkloadMessageKind& kind)
+    {
+        if(generated_ < GetWarmupCount()){
+            ++generated_;
+            kind = WorkloadMessageKind::Add;
+            return MakeAdd(generated_ % 2 ? Side::Buy : Side::Sell, 0);
+        }
+        ++generated_;
+        std::uint64_t timestamp = NextArrival();
+        if(Chance(config_.midMoveProbability_)){
+            mid_ += Chance(0.5) ? 1 : -1;
+        }
+
+        kind = static_cast<WorkloadMessageKind>(kinds_(rng_));
+        // Hold the book near its target depth whatever the mix
+        std::size_t target = config_.depth_ * 2;
+        if(kind == WorkloadMessageKind::Add && live_.size() > target + target / 8 + 1){
+            kind = WorkloadMessageKind::Cancel;
+        }
+        if((kind == WorkloadMessageKind::Cancel && live_.size() < target - target / 8) || live_.empty()){
+            kind = WorkloadMessageKind::Add;
+        }
+
+        switch(kind)
+        {
+        case WorkloadMessageKind::Cancel:
+        {
+            LiveOrder order = TakeLive();
+            return OrderMessage::FromRequest(config_.symbol_, OrderRequest::Cancel(order.orderId_), timestamp);
+        }
+        case WorkloadMessageKind::Modify:
+        {
+            const LiveOrder& order = live_[PickLive()];
+            OrderModify modify{ order.orderId_, order.side_, PassivePrice(order.side_), DrawQuantity() };
+            return OrderMessage::FromRequest(config_.symbol_, OrderRequest::Modify(modify), timestamp);
+        }
+        case WorkloadMessageKind::FillAndKill:
+        {
+            // Priced through the touch by up to two ticks
+            Side side = Chance(0.5) ? Side::Buy : Side::Sell;
+            Price through = static_cast<Price>(1 + rng_() % 3);
+            Price price = side == Side::Buy ? mid_ + through : mid_ - through;
+            Order order{ OrderType::FillandKill, nextOrderId_++, side, price, DrawQuantity() };
+            return OrderMessage::FromRequest(config_.symbol_, OrderRequest::Add(order), timestamp);
+        }
+        case WorkloadMessageKind::Add:
+        case WorkloadMessageKind::Count:
+            break;
+        }
+        kind = WorkloadMessageKind::Add;
+        return MakeAdd(Chance(0.5) ? Side::Buy : Side::Sell, timestamp);
+    }
+
+    OrderMessage Next()
+    {
+        WorkloadMessageKind kind;
+        return Next(kind);
+    }
+
+private:
+    struct LiveOrder
+    {
+        OrderId orderId_;
+        Side side_;
+    };
+
+    bool Chance(double probability)
+    {
+        return std::uniform_real_distribution<double>{ 0.0, 1.0 }(rng_) < probability;
+    }
+
+    Quantity DrawQuantity()
+    {
+        return static_cast<Quantity>(1 + rng_() % static_cast<std::uint64_t>(std::max<Quantity>(config_.maxQuantity_, 1)));
+    }
+
+    // One tick behind the mid is the touch; the distance behind it is power-law
+    Price PassivePrice(Side side)
+    {
+        double u = std::uniform_real_distribution<double>{ 0.0, 1.0 }(rng_);
+        double scaled = std::pow(u, config_.distanceExponent_) * static_cast<double>(config_.levels_);
+        Price distance = static_cast<Price>(std::min<double>(scaled, static_cast<double>(std::max<Price>(config_.levels_ - 1, 0))));
+        return side == Side::Buy ? mid_ - 1 - distance : mid_ + 1 + distance;
+    }
+
+    OrderMessage MakeAdd(Side side, std::uint64_t timestamp)
+    {
+        Order order{ OrderType::GoodTillCancel, nextOrderId_++, side, PassivePrice(side), DrawQuantity() };
+        live_.push_back(LiveOrder{ order.GetOrderId(), side });
+        return OrderMessage::FromRequest(config_.symbol_, OrderRequest::Add(order), timestamp);
+    }
+
+    std::size_t PickLive()
+    {
+        return static_cast<std::size_t>(rng_() % live_.size());
+    }
+
+    LiveOrder TakeLive()
+    {
+        std::size_t index = PickLive();
+        LiveOrder order = live_[index];
+        live_[index] = live_.back();
+        live_.pop_back();
+        return order;
+    }
+
+    std::uint64_t NextArrival()
+    {
+        if(config_.rate_ <= 0){
+            return 0;
+        }
+        if(inBurst_){
+            inBurst_ = !Chance(1.0 / std::max(config_.burstLength_, 1.0));
+        }
+        else{
+            inBurst_ = Chance(config_.burstProbability_);
+        }
+        double rate = config_.rate_ * (inBurst_ ? config_.burstMultiplier_ : 1.0);
+        clock_ += std::exponential_distribution<double>{ rate }(rng_) * 1e9;
+        return static_cast<std::uint64_t>(clock_);
+    }
+
+    WorkloadConfig config_;
+    std::mt19937_64 rng_;
+    OrderId nextOrderId_;
+    Price mid_;
+    std::discrete_distribution<int> kinds_;
+    std::vector<LiveOrder> live_;
+    std::size_t generated_{ 0 };
+    bool inBurst_{ false };
+    double clock_{ 0 };          // Scheduled time of the last message, ns
+};